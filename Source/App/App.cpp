@@ -1,30 +1,209 @@
 #include "App.hpp"
 
+#include <cstdlib>
+#include <exception>
+#include <thread>
+
 #include "AppWindow.hpp"
+#include "Core/JobSystem.hpp"
+#include "FixedTimestep.hpp"
 #include "GpuApi/Device.hpp"
 #include "Window/WindowConnection.hpp"
 
-App::App(const String& _name) : name(_name) {
-    device           = new Device;
-    windowConnection = WindowConnection::create();
+// How often the deletion queue is processed with render threads, while no input arrives
+const i32 DELETION_INTERVAL_MS = 10;
+// Stops the tick thread when stored in queuedTicks
+const u32 STOP_TICKS = UINT32_MAX;
+
+App::App(const String& _name, const AppConfig& _config) : name(_name), config(_config) {
+    StartupTrace::Scope scope(&startupTrace, "App");
+    jobSystem = new JobSystem;
+    eventLoop = new EventLoop;
+
+    // The display connection doesn't need the device, it is set up on a worker while the device is created.
+    // Errors are rethrown here, an exception escaping a job would terminate
+    std::exception_ptr connectionError, deviceError;
+    jobSystem->submit([this, &connectionError](u32 thread) {
+        StartupTrace::Scope scope(&startupTrace, "Window connection", thread);
+        try {
+            // Input read on the input thread has to end a wait as well, the fd only covers what is read here
+            windowConnection = WindowConnection::create(config.inputThread, [this]() { eventLoop->wake(); });
+        } catch (...) {
+            connectionError = std::current_exception();
+        }
+    });
+    {
+        StartupTrace::Scope scope(&startupTrace, "Device");
+        try {
+            device = new Device(config.device);
+        } catch (...) {
+            deviceError = std::current_exception();
+        }
+    }
+    // The job uses this, it has to finish before the constructor is left either way
+    jobSystem->wait();
+    if (connectionError or deviceError) {
+        delete device;
+        delete windowConnection;  // Before the event loop its input thread wakes
+        delete eventLoop;
+        delete jobSystem;
+        std::rethrow_exception(deviceError ? deviceError : connectionError);
+    }
+
+    windowConnection->addToEventLoop(eventLoop);
+
+    if (config.tickRate > 0.0) timestep = new FixedTimestep(config.tickRate, config.maxTicksPerFrame);
 }
 
 App::~App() {
     for (AppWindow* w : windows) delete w;
 
-    delete windowConnection;
+    // Runs the deferred destructions queued by the windows, which still need the window connection
     delete device;
+    delete windowConnection;
+    delete eventLoop;  // After the connection, whose input thread wakes it
+    delete jobSystem;
+    delete timestep;
 }
 
 void App::run() {
-    init();
+    {
+        StartupTrace::Scope scope(&startupTrace, "App::init");
+        init();
+    }
+
+    i32 tickTimer = -1;
+    if (timestep) {
+        // Only ends the wait of an idle loop, the ticks that are due are counted from the clock
+        tickTimer = eventLoop->addTimer([](u64) {});
+        eventLoop->setTimer(tickTimer, timestep->getStep(), timestep->getStep());
+        if (config.tickThread) tickThread = std::thread(&App::runTickThread, this);
+    }
 
+    if (config.renderThreads)
+        runRenderThreads();
+    else
+        runWindows();
+
+    if (tickThread.joinable()) {
+        waitForTickThread();
+        queuedTicks = STOP_TICKS;
+        queuedTicks.notify_one();
+        tickThread.join();
+    }
+    if (tickTimer != -1) eventLoop->removeTimer(tickTimer);
+
+    device->waitIdle();
+}
+
+void App::exit() {
+    running = false;
+    eventLoop->wake();
+}
+
+void App::runWindows() {
     while (running) {
+        // Reads what arrived while the windows were updated and sends their requests before waiting
         windowConnection->update();
-        for (AppWindow* w : windows) w->update();
+
+        bool idle = true;
+        for (AppWindow* w : windows) idle = idle and !w->needsUpdate();
+        eventLoop->poll(idle ? -1 : 0);
+        updateSimulation();
+
+        for (AppWindow* w : windows) {
+            if (w->needsUpdate()) w->update();
+        }
+        device->processDeletionQueue();
     }
+}
 
-    device->waitIdle();
+void App::runRenderThreads() {
+    Vec<std::thread> renderThreads;
+    for (AppWindow* w : windows) {
+        renderThreads.push(std::thread([this, w]() {
+            while (running) {
+                w->waitForUpdate();
+                if (running) w->update();
+            }
+        }));
+    }
+
+    // The windows pace themselves, this thread only handles input, which wakes it right away, and the
+    // deletion queue, which can wait
+    while (running) {
+        eventLoop->poll(DELETION_INTERVAL_MS);
+        windowConnection->update();
+        updateSimulation();
+        // Render threads sleep until their window has something to do, events are the one thing they can't
+        // notice themselves
+        for (AppWindow* w : windows) {
+            if (w->hasPendingEvents()) w->notifyUpdate();
+        }
+        device->processDeletionQueue();
+    }
+
+    for (AppWindow* w : windows) w->notifyUpdate();
+    for (std::thread& t : renderThreads) t.join();
+}
+
+void App::addWindow(AppWindow* window) { windows.push(window); }
+
+void App::finishStartup(FrameClock::time_point frameStart) {
+    startupTrace.record("First frame", frameStart, FrameClock::now());
+    if (startupTrace.finish() and std::getenv("XV_STARTUP_TRACE")) startupTrace.print();
+}
+
+f64 App::getTickAlpha() const { return tickAlpha.load(std::memory_order_relaxed); }
+
+void App::updateSimulation() {
+    if (!timestep) return;
+
+    // The ticks handed over last frame ran while the windows rendered the state before them
+    if (ticksQueued) {
+        waitForTickThread();
+        ticksQueued = false;
+        publishSimulation(queuedAlpha);
+    }
+
+    u32 count = timestep->advance(FrameClock::now());
+    if (count == 0) {
+        // No new states, the published ones are the latest and the alpha of this advance belongs to them
+        tickAlpha.store(timestep->getAlpha(), std::memory_order_relaxed);
+        return;
+    }
+    if (config.tickThread) {
+        // This alpha belongs to the states after the queued ticks, until they are published the old one stays
+        queuedAlpha = timestep->getAlpha();
+        ticksQueued = true;
+        queuedTicks = count;
+        queuedTicks.notify_one();
+    } else {
+        for (u32 i = 0; i < count; i++) tick(timestep->getDelta());
+        publishSimulation(timestep->getAlpha());
+    }
+}
+
+void App::publishSimulation(f64 alpha) {
+    publishTicks();
+    tickAlpha.store(alpha, std::memory_order_relaxed);
+    for (AppWindow* w : windows) w->requestRedraw();
+}
+
+void App::runTickThread() {
+    while (true) {
+        queuedTicks.wait(0);
+        u32 count = queuedTicks.load();
+        if (count == STOP_TICKS) return;
+
+        for (u32 i = 0; i < count; i++) tick(timestep->getDelta());
+        queuedTicks = 0;
+        queuedTicks.notify_one();
+        // The loop may be idle, the ticks are published as soon as they are done instead of on the next tick
+        eventLoop->wake();
+    }
 }
 
-void App::addWindow(AppWindow* window) { windows.push(window); }
\ No newline at end of file
+void App::waitForTickThread() {
+    while (u32 count = queuedTicks.load()) queuedTicks.wait(count);
+}
@@ -1,39 +1,128 @@
 #pragma once
 
+#include <atomic>
+#include <thread>
+
 #include "Core/Core.hpp"
+#include "Core/EventLoop.hpp"
+#include "GpuApi/Common.hpp"
+#include "StartupTrace.hpp"
 
 class AppWindow;
 class Device;
+class FixedTimestep;
+class JobSystem;
 class WindowConnection;
 
+struct AppConfig {
+    DeviceConfig device;
+    /**
+     * Renders every window on its own thread, so a window waiting on its fence or swapchain doesn't delay the
+     * others. Window events are still dispatched on the thread calling run().
+     */
+    bool renderThreads = false;
+    /**
+     * Reads input on a dedicated thread, so it is queued on the windows even while the thread dispatching
+     * window events is busy. Only used on Wayland.
+     */
+    bool inputThread = false;
+    /// Rate of App::tick in Hz, 0 for no fixed timestep simulation
+    f64 tickRate = 0.0;
+    /// Most ticks run per frame, after a stall the simulation slows down instead of trying to catch up
+    u32 maxTicksPerFrame = 8;
+    /**
+     * Runs the ticks on a dedicated thread, while the windows render the state the ticks of the previous
+     * frame produced. Without it they run on the thread calling run(), before the windows are updated.
+     */
+    bool tickThread = false;
+};
+
 /**
  * @brief Base application class
+ *
+ * The thread calling run only ever blocks in the event loop, which wakes for input, timers and work posted
+ * from other threads. Windows are only updated while they have something to do, see AppWindow::needsUpdate,
+ * so an application nothing happens in uses no CPU.
  */
 class App {
     friend class AppWindow;
 
    private:
     const String name;
+    const AppConfig config;
     Vec<AppWindow*> windows;
 
-    Device* device;
-    WindowConnection* windowConnection;
+    Device* device = nullptr;
+    JobSystem* jobSystem;
+    EventLoop* eventLoop;
+    WindowConnection* windowConnection = nullptr;
+
+    std::atomic<bool> running = true;
+    StartupTrace startupTrace;
 
-    bool running = true;
+    FixedTimestep* timestep = nullptr;
+    std::thread tickThread;
+    /// Ticks handed to the tick thread, it resets this to 0 when they are done
+    std::atomic<u32> queuedTicks = 0;
+    bool ticksQueued             = false;
+    f64 queuedAlpha              = 0.0;  ///< Alpha of the advance that queued the ticks
+    /// Alpha matching the last published states, read by render threads
+    std::atomic<f64> tickAlpha = 0.0;
 
    protected:
     virtual void init() {}
 
+    /// Advances the simulation by one step of dt seconds, see AppConfig::tickRate
+    virtual void tick(f64 dt) {}
+    /**
+     * @brief Called on the thread calling run() after ticks ran and before the windows are updated.
+     *
+     * Nothing ticks during the call, so the state the ticks wrote can be copied or swapped into the one that
+     * is rendered, with a tick thread this is the only safe point for that. The windows are redrawn after it,
+     * with render threads they keep rendering during the call though.
+     */
+    virtual void publishTicks() {}
+
    public:
-    explicit App(const String& name);
+    explicit App(const String& name, const AppConfig& config = {});
     ~App();
 
     void run();
 
+    /// With render threads, windows have to be added before run() starts them, i.e. from init()
     void addWindow(AppWindow* window);
 
-    inline void exit() { running = false; }
+    /// Can be called from any thread
+    void exit();
 
     [[nodiscard]] inline const String& getName() const { return name; }
     inline Device* getDevice() { return device; }
+    inline JobSystem* getJobSystem() { return jobSystem; }
+    /// Runs on the thread calling run(), fds and timers can only be added from there, e.g. from init()
+    inline EventLoop* getEventLoop() { return eventLoop; }
+    [[nodiscard]] inline bool hasRenderThreads() const { return config.renderThreads; }
+    /// Covers construction up to the first presented frame, printed then if XV_STARTUP_TRACE is set
+    inline StartupTrace* getStartupTrace() { return &startupTrace; }
+
+    /**
+     * @brief How far the simulation is into the next tick, in [0, 1), for interpolating between the last two
+     * published states while rendering. 0 without a fixed timestep.
+     *
+     * Can be called from any thread. It is updated after publishTicks(), so it always refers to the published
+     * states, also while the tick thread is still running newer ticks.
+     */
+    [[nodiscard]] f64 getTickAlpha() const;
+
+   private:
+    /// Called by the windows after presenting while the startup trace isn't finished
+    void finishStartup(FrameClock::time_point frameStart);
+
+    void runWindows();
+    void runRenderThreads();
+
+    /// Runs the ticks that are due, or hands them to the tick thread, and publishes finished ones
+    void updateSimulation();
+    void publishSimulation(f64 alpha);
+    void runTickThread();
+    void waitForTickThread();
 };
\ No newline at end of file
@@ -1,53 +1,136 @@
 #include "AppWindow.hpp"
 
+#include <exception>
+
 #include "App.hpp"
+#include "Core/JobSystem.hpp"
 #include "GpuApi/GpuApi.hpp"
 #include "Input/Event.hpp"
 #include "Render/UIRenderer.hpp"
 #include "Window/Window.hpp"
 #include "Window/WindowConnection.hpp"
 
+// Out of date swapchains are recreated, any other error can't be recovered from
+static void checkFrameResult(VkResult result) {
+    if (result < 0 and result != VK_ERROR_OUT_OF_DATE_KHR)
+        throw std::runtime_error(std::format("Failed to present a frame (VkResult {})", (i32)result));
+}
+
 AppWindow::AppWindow(App* _app, const String& title) : app(_app), device(app->getDevice()) {
-    window = app->windowConnection->createWindow();
+    StartupTrace* trace = app->getStartupTrace();
+    StartupTrace::Scope scope(trace, "AppWindow");
 
-    window->setTitle(title);
-    window->setExitCallback([this]() { app->exit(); });
-    window->setResizeCallback([this](const ResizeEvent& e) {
-        width = e.width, height = e.height;
-        resize();
-    });
+    window = app->windowConnection->createWindow();
+    try {
+        window->setTitle(title);
+        surface = new Surface(device, window);
 
-    surface       = new Surface(device, window);
-    surfaceFormat = surface->getSupportedFormats()[0];
-    config        = {
-               .format      = surfaceFormat.format,
-               .colorSpace  = surfaceFormat.colorSpace,
-               .presentMode = VK_PRESENT_MODE_FIFO_KHR,
-               .width       = 800,
-               .height      = 600,
-    };
+        // The renderer only holds on to the surface, creating its shaders overlaps with creating the
+        // swapchain. Windows are created on the thread calling run(), the one driving the job system
+        JobSystem* startupJobs = app->getJobSystem();
+        std::exception_ptr rendererError;
+        startupJobs->submit([this, trace, &rendererError](u32 thread) {
+            StartupTrace::Scope scope(trace, "UIRenderer", thread);
+            // With render threads every window already records on its own thread, and the job system only
+            // supports being driven from one thread
+            JobSystem* jobSystem = app->hasRenderThreads() ? nullptr : app->getJobSystem();
+            try {
+                uiRenderer = new UIRenderer(device, jobSystem, surface, width, height);
+            } catch (...) {  // Rethrown below, an exception escaping a job would terminate
+                rendererError = std::current_exception();
+            }
+        });
 
-    uiRenderFinished = new Semaphore(device);
-    imageAvailable   = new Semaphore(device);
+        try {
+            StartupTrace::Scope swapchainScope(trace, "Swapchain");
+            surfaceFormat = surface->getSupportedFormats()[0];
+            config        = {
+                       .format      = surfaceFormat.format,
+                       .colorSpace  = surfaceFormat.colorSpace,
+                       .presentMode = VK_PRESENT_MODE_FIFO_KHR,
+                       .width       = width,
+                       .height      = height,
+            };
+            minimized = !surface->configure(config);
+            pacer     = new FramePacer(surface, &frameStats);
 
-    uiRenderer = new UIRenderer(device, surface, width, height);
+            uiRenderFinished = new Semaphore(device);
+            imageAvailable   = new Semaphore(device);
+        } catch (...) {
+            // The job uses this, it has to finish before the constructor is left
+            startupJobs->wait();
+            throw;
+        }
 
-    resize();
+        startupJobs->wait();
+        if (rendererError) std::rethrow_exception(rendererError);
+        if (!minimized) updateViewport();
+    } catch (...) {
+        destroy();
+        throw;
+    }
 }
 
-AppWindow::~AppWindow() {
+AppWindow::~AppWindow() { destroy(); }
+
+void AppWindow::destroy() {
+    // A present still queued on the submit thread uses the swapchain
+    device->getGraphicsQueue()->flushSubmissions();
+
     delete child;
-    delete uiRenderFinished, delete imageAvailable;
     delete uiRenderer;
+    delete pacer;
     delete surface;
-    delete window;
+
+    // The native window has to outlive its VkSurfaceKHR, whose destruction is deferred
+    Window* w     = window;
+    Semaphore* s1 = imageAvailable;
+    Semaphore* s2 = uiRenderFinished;
+    device->destroyDeferred([w, s1, s2]() {
+        delete s1;
+        delete s2;
+        delete w;
+    });
 }
 
 void AppWindow::update() {
-    surface->getNextImageIndex(UINT64_MAX, imageAvailable, nullptr, imageIndex);
+    window->pollEvents(events);
+    for (const Event& e : events) {
+        switch (e.kind) {
+            case EventKind::Close: app->exit(); break;
+            case EventKind::Resize:
+                // Only record the size, the swapchain is recreated once at the start of the frame. The queue
+                // already coalesced a burst of resizes during an interactive resize into one
+                requestedWidth = e.resize.width, requestedHeight = e.resize.height;
+                resizePending = true;
+                break;
+            default: break;
+        }
+    }
+
+    processPresentFeedback();
+
+    VkPresentModeKHR presentMode;
+    {
+        std::lock_guard lock(requestMutex);
+        presentMode = requestedPresentMode;
+    }
+    if (resizePending or presentMode != surface->getPresentMode()) {
+        resizePending = false;
+        resize(requestedWidth, requestedHeight, presentMode);
+    }
+    if (minimized) return;
+
+    // Swapchains are externally synchronized, with a submit thread the previous present has to be made before
+    // the swapchain is waited on or acquired from. The UI is built in between to overlap with the present
+    Queue* queue = device->getGraphicsQueue();
+    if (device->supportsPresentWait()) checkFrameResult(queue->flushSubmissions());
 
-    surface->getImages()[imageIndex]->transitionLayout(VK_IMAGE_LAYOUT_UNDEFINED,
-                                                       VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    f64 paceWait    = pacer->waitForFrameStart();
+    auto frameStart = FrameClock::now();
+    frameIndex++;
+    // Cleared before the UI is built, a request made while it is built still gets its frame
+    redrawPending = false;
 
     UIDrawData drawData;
     drawData.setColor({0.1, 0.1, 0.1, 1.0});
@@ -63,20 +146,143 @@ void AppWindow::update() {
             child->draw(drawData, minSize);
         }
     }
+    damage.update(drawData.getDrawCommands(), width, height);
+    const Damage& frameDamage = damage.getFrameDamage();
+    if (frameDamage.full or frameDamage.rects.getSize() > 0) redrawPending = true;
+
+    checkFrameResult(queue->flushSubmissions());
+    VkResult result = surface->getNextImageIndex(UINT64_MAX, imageAvailable, nullptr, imageIndex);
+    checkFrameResult(result);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {  // Nothing was acquired, recreate and retry next frame
+        resizePending = true;
+        return;
+    }
+    if (result == VK_SUBOPTIMAL_KHR) resizePending = true;  // Still has to be presented
+
+    // Layout transitions of the swapchain image are recorded by the render graph. The image only needs what
+    // changed since it was last drawn, the compositor only what changed since the previous present
+    Damage bufferDamage = damage.getBufferDamage(imageIndex);
+    uiRenderer->render(drawData, imageIndex, bufferDamage, imageAvailable, uiRenderFinished);
+    updatePresentRegions();
+
+    // Belongs to the next commit of the surface, which the present makes, also with a submit thread
+    window->requestPresentFeedback(frameIndex);
+    result = queue->present({uiRenderFinished}, surface, imageIndex, frameIndex, presentRegions);
+    checkFrameResult(result);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR or result == VK_SUBOPTIMAL_KHR) resizePending = true;
 
-    uiRenderer->render(drawData, imageIndex, imageAvailable, uiRenderFinished);
+    FrameTiming timing{
+        .frameIndex    = frameIndex,
+        .start         = frameStart,
+        .paceWait      = paceWait,
+        .cpuTime       = toMilliseconds(FrameClock::now() - frameStart),
+        .frameInterval = frameIndex > 1 ? toMilliseconds(frameStart - lastFrameStart) : 0.0,
+    };
+    frameStats.record(timing);
+    pacer->framePresented(timing);
+    lastFrameStart = frameStart;
+
+    // Startup ends with the first frame any window presents
+    if (!app->getStartupTrace()->isFinished()) app->finishStartup(frameStart);
+}
+
+void AppWindow::resize(u32 _width, u32 _height, VkPresentModeKHR presentMode) {
+    config.width = _width, config.height = _height;
+    checkFrameResult(device->getGraphicsQueue()->flushSubmissions());
+
+    // The old swapchain is passed as oldSwapchain and retired through the device deletion queue, no wait here
+    if (presentMode != surface->getPresentMode()) {
+        config.presentMode = presentMode;
+        minimized          = !surface->configure(config);
+    } else
+        minimized = !surface->resize(_width, _height);
+
+    pacer->reset();
+    // The new swapchain images have no contents yet
+    damage.invalidateBuffers();
+    if (!minimized) updateViewport();
+}
+
+void AppWindow::processPresentFeedback() {
+    window->pollPresentFeedback(presentFeedback);
+    for (const PresentFeedback& f : presentFeedback) {
+        PresentTiming present{
+            .discarded       = f.discarded,
+            .refreshInterval = f.refreshInterval / 1e6,
+            .sequence        = f.sequence,
+            .vsync           = f.vsync,
+            .zeroCopy        = f.zeroCopy,
+        };
+        // FrameClock is the monotonic clock on Linux, which the window reports times in
+        if (f.presentTime)
+            present.presentTime = FrameClock::time_point(std::chrono::nanoseconds(f.presentTime));
+        frameStats.setPresentTiming(f.frameIndex, present);
+    }
+}
 
-    surface->getImages()[imageIndex]->transitionLayout(VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                                                       VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+void AppWindow::updatePresentRegions() {
+    presentRegions.clear();
+    const Damage& frameDamage = damage.getFrameDamage();
+    if (frameDamage.full) return;  // No regions means the whole image
 
-    device->getGraphicsQueue()->present({uiRenderFinished}, surface, imageIndex);
+    for (const IRect& r : frameDamage.rects) {
+        presentRegions.push({
+            .offset = {r.x, r.y},
+            .extent = {(u32)r.w, (u32)r.h},
+            .layer  = 0,
+        });
+    }
+    // An unchanged frame is still presented for pacing, an empty rect tells the compositor nothing changed
+    if (presentRegions.getSize() == 0) presentRegions.push({.offset = {0, 0}, .extent = {0, 0}, .layer = 0});
 }
 
-void AppWindow::resize() {
-    config.width = width, config.height = height;
+void AppWindow::updateViewport() {
+    VkExtent2D extent = surface->getExtent();
+    width = extent.width, height = extent.height;
     viewport = {2, 2, f32(width - 4), f32(height - 4)};
-    surface->configure(config);
     uiRenderer->resize(width, height);
 }
 
-void AppWindow::setChild(Widget* _child) { child = _child; }
\ No newline at end of file
+void AppWindow::setChild(Widget* _child) {
+    child = _child;
+    requestRedraw();
+}
+
+bool AppWindow::needsUpdate() {
+    if (resizePending or window->hasPendingEvents()) return true;
+    {
+        std::lock_guard lock(requestMutex);
+        if (requestedPresentMode != surface->getPresentMode()) return true;
+    }
+    // A minimized window is redrawn once it is restored, which comes with a resize
+    return redrawPending and !minimized;
+}
+
+void AppWindow::waitForUpdate() {
+    std::unique_lock lock(wakeMutex);
+    wakeCondition.wait(lock, [this]() { return woken or needsUpdate(); });
+    woken = false;
+}
+
+void AppWindow::notifyUpdate() {
+    {
+        std::lock_guard lock(wakeMutex);
+        woken = true;
+    }
+    wakeCondition.notify_one();
+}
+
+void AppWindow::requestRedraw() {
+    redrawPending = true;
+    notifyUpdate();
+    app->getEventLoop()->wake();
+}
+
+void AppWindow::setPresentMode(VkPresentModeKHR presentMode) {
+    {
+        std::lock_guard lock(requestMutex);
+        requestedPresentMode = surface->choosePresentMode(presentMode);
+    }
+    notifyUpdate();
+    app->getEventLoop()->wake();
+}
\ No newline at end of file
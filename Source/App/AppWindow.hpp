@@ -1,33 +1,66 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
 #include "Core/Core.hpp"
 #include "Core/Math.hpp"
+#include "FramePacer.hpp"
+#include "FrameStats.hpp"
 #include "GpuApi/GpuApi.hpp"
+#include "Input/Event.hpp"
+#include "UI/Damage.hpp"
 #include "UI/UI.hpp"
+#include "Window/Window.hpp"
 
 class App;
-class Window;
 class UIRenderer;
 
 class AppWindow {
    private:
     App* app;
-    Window* window;
+    Window* window = nullptr;
 
     Device* device;
-    Surface* surface;
+    Surface* surface = nullptr;
     SurfaceConfig config{};
     VkSurfaceFormatKHR surfaceFormat{};
     u32 imageIndex = 0;
-    Semaphore* imageAvailable;
-    Semaphore* uiRenderFinished;
+    // Owned directly instead of through device handles, so they can be used without locking the device pools
+    Semaphore* imageAvailable   = nullptr;
+    Semaphore* uiRenderFinished = nullptr;
 
     u32 width = 800, height = 600;
     Rect viewport;
+    bool minimized = false;
+
+    Vec<Event> events;  ///< Reused every frame
+    u32 requestedWidth = 800, requestedHeight = 600;
+    bool resizePending = false;
+
+    // setPresentMode can be called from any thread
+    std::mutex requestMutex;
+    VkPresentModeKHR requestedPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+
+    // Blocks a render thread while the window has nothing to do
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    bool woken = false;
+
+    u64 frameIndex = 0;
+    FrameClock::time_point lastFrameStart{};
+    FrameStats frameStats;
+    Vec<PresentFeedback> presentFeedback;  ///< Reused every frame
+    FramePacer* pacer = nullptr;
 
-    UIRenderer* uiRenderer;
+    UIRenderer* uiRenderer = nullptr;
+    DamageTracker damage;
+    Vec<VkRectLayerKHR> presentRegions;  ///< Reused every frame
+    /// Set until a frame is drawn that doesn't differ from the previous one
+    std::atomic<bool> redrawPending = true;
 
-    Widget* child;
+    Widget* child = nullptr;
 
    public:
     explicit AppWindow(App* app, const String& title);
@@ -35,10 +68,42 @@ class AppWindow {
 
     void setChild(Widget* child);
 
+    /// Renders a frame, can run on a render thread while events are dispatched on the main thread
     void update();
 
+    /**
+     * @brief Whether update has anything to do: events arrived, the swapchain has to be recreated or the last
+     * frame still changed something.
+     *
+     * Windows are only updated while this is true, so a window whose contents settled doesn't render until
+     * something happens. Has to be called from the thread calling update.
+     */
+    [[nodiscard]] bool needsUpdate();
+
+    /// Blocks the render thread of the window until needsUpdate is true or notifyUpdate is called
+    void waitForUpdate();
+    /// Ends waitForUpdate, e.g. after events were queued on the window. Can be called from any thread
+    void notifyUpdate();
+    [[nodiscard]] inline bool hasPendingEvents() { return window->hasPendingEvents(); }
+
+    /// Draws at least one more frame, for changes that don't come from events. Can be called from any thread
+    void requestRedraw();
+
+    /// Falls back to the closest supported mode, applied at the start of the next frame
+    void setPresentMode(VkPresentModeKHR presentMode);
+    inline void setFramePacing(bool enabled) { pacer->setEnabled(enabled); }
+
+    [[nodiscard]] inline const FrameStats& getFrameStats() const { return frameStats; }
+
     inline App* getApp() { return app; }
 
    private:
-    void resize();
+    /// Destroys what was created, also by a constructor that didn't finish
+    void destroy();
+    void resize(u32 width, u32 height, VkPresentModeKHR presentMode);
+    void updateViewport();
+    /// Converts the damage of the frame into the rects passed to present
+    void updatePresentRegions();
+    /// Moves the presentation feedback the window received into the frame stats
+    void processPresentFeedback();
 };
@@ -0,0 +1,34 @@
+#include "FixedTimestep.hpp"
+
+#include <stdexcept>
+
+FixedTimestep::FixedTimestep(f64 rate, u32 _maxSteps) : maxSteps(_maxSteps) {
+    if (rate <= 0.0 or maxSteps == 0) throw std::runtime_error("Invalid fixed timestep configuration");
+    step = std::chrono::duration_cast<FrameClock::duration>(std::chrono::duration<f64>(1.0 / rate));
+}
+
+u32 FixedTimestep::advance(FrameClock::time_point now) {
+    if (!started) {
+        started  = true;
+        lastTime = now;
+        return 0;
+    }
+    accumulator += now - lastTime;
+    lastTime = now;
+
+    u64 steps = accumulator / step;
+    if (steps > maxSteps) {  // Spiral of death, keep only the fraction of a step
+        steps       = maxSteps;
+        accumulator = accumulator % step;
+    } else
+        accumulator -= steps * step;
+
+    alpha = (f64)accumulator.count() / (f64)step.count();
+    return (u32)steps;
+}
+
+void FixedTimestep::reset() {
+    started     = false;
+    accumulator = {};
+    alpha       = 0.0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Core/Core.hpp"
+#include "FrameStats.hpp"
+
+/**
+ * @brief Turns the real time between frames into a whole number of fixed simulation steps.
+ *
+ * Elapsed time is accumulated and consumed in steps, the remainder carries over to the next frame. It is also
+ * how far the simulation is into the next step, which rendering uses to interpolate between the last two
+ * states, so motion looks smooth whatever the ratio of step rate and frame rate is.
+ *
+ * When steps take longer than the time they cover, every frame would have to run more of them. At most
+ * maxSteps run per frame and the time of the others is dropped, the simulation then runs slower than real
+ * time instead of falling further behind.
+ */
+class FixedTimestep {
+   private:
+    FrameClock::duration step;
+    u32 maxSteps;
+
+    FrameClock::time_point lastTime{};
+    FrameClock::duration accumulator{};
+    bool started = false;
+    f64 alpha    = 0.0;
+
+   public:
+    /// @param rate Steps per second.
+    FixedTimestep(f64 rate, u32 maxSteps);
+
+    /// Adds the time since the last call and returns how many steps it covers, nothing on the first call
+    u32 advance(FrameClock::time_point now);
+
+    /// Forgets the accumulated time, e.g. after a pause, so the next call doesn't catch up on it
+    void reset();
+
+    /// Fraction of a step accumulated after the last advance, in [0, 1). For rendering see App::getTickAlpha
+    [[nodiscard]] inline f64 getAlpha() const { return alpha; }
+    [[nodiscard]] inline FrameClock::duration getStep() const { return step; }
+    /// Length of a step in seconds
+    [[nodiscard]] inline f64 getDelta() const { return std::chrono::duration<f64>(step).count(); }
+};
@@ -0,0 +1,55 @@
+#include "FramePacer.hpp"
+
+#include <thread>
+
+#include "GpuApi/Device.hpp"
+#include "GpuApi/Surface.hpp"
+
+// Exponential moving average, seeded with the first sample
+static f64 smooth(f64 average, f64 sample, f64 factor) {
+    return average == 0.0 ? sample : average + (sample - average) * factor;
+}
+
+FramePacer::FramePacer(Surface* _surface, FrameStats* _stats) : surface(_surface), stats(_stats) {}
+
+f64 FramePacer::waitForFrameStart() {
+    auto begin            = FrameClock::now();
+    VkPresentModeKHR mode = surface->getPresentMode();
+    bool vsync = mode == VK_PRESENT_MODE_FIFO_KHR or mode == VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+
+    if (pendingPresentId and surface->getDevice()->supportsPresentWait()) {
+        // Without vsync presents complete as fast as possible, so only poll to measure latency
+        u64 timeout     = enabled and vsync ? WAIT_TIMEOUT : 0;
+        VkResult result = surface->waitForPresent(pendingPresentId, timeout);
+        if (result == VK_SUCCESS) {
+            if (const FrameTiming* t = stats->getFrame(pendingPresentId))
+                stats->setLatency(pendingPresentId, toMilliseconds(FrameClock::now() - t->start));
+            pendingPresentId = 0;
+        } else if (timeout) {  // Timed out or the swapchain is out of date, don't get stuck on it
+            pendingPresentId = 0;
+        }
+    } else if (enabled and vsync and refreshInterval > 0.0) {
+        // Start just early enough for the CPU work to finish before the next refresh
+        f64 startOffset = refreshInterval - cpuTimeEstimate - SAFETY_MARGIN;
+        auto target     = lastFrameStart + std::chrono::duration_cast<FrameClock::duration>(
+                                           std::chrono::duration<f64, std::milli>(startOffset));
+        if (target > begin) std::this_thread::sleep_until(target);
+    }
+
+    return toMilliseconds(FrameClock::now() - begin);
+}
+
+void FramePacer::framePresented(const FrameTiming& timing) {
+    if (!pendingPresentId) pendingPresentId = timing.frameIndex;
+
+    cpuTimeEstimate = smooth(cpuTimeEstimate, timing.cpuTime, SMOOTHING);
+    // In vsync modes frames settle on the refresh interval
+    if (timing.frameInterval > 0.0)
+        refreshInterval = smooth(refreshInterval, timing.frameInterval, SMOOTHING);
+    lastFrameStart = timing.start;
+}
+
+void FramePacer::reset() {
+    pendingPresentId = 0;
+    refreshInterval  = 0.0;
+}
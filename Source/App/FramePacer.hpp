@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Core/Core.hpp"
+#include "FrameStats.hpp"
+
+class Surface;
+
+/**
+ * @brief Delays the start of a frame to keep input-to-photon latency low.
+ *
+ * With present wait available, the CPU waits until the previous frame is displayed before starting the next
+ * one, so at most one frame is queued. Otherwise, in vsync present modes, it sleeps until the predicted
+ * latest start time that still makes the next refresh. Without vsync only the latency is measured.
+ */
+class FramePacer {
+   private:
+    static constexpr f64 SAFETY_MARGIN = 1.0;  // ms
+    static constexpr f64 SMOOTHING     = 0.1;
+    static constexpr u64 WAIT_TIMEOUT  = 100'000'000;  // ns
+
+    Surface* surface;
+    FrameStats* stats;
+    bool enabled = true;
+
+    u64 pendingPresentId = 0;
+    f64 refreshInterval  = 0.0;  // Estimated, ms
+    f64 cpuTimeEstimate  = 0.0;  // ms
+    FrameClock::time_point lastFrameStart{};
+
+   public:
+    FramePacer(Surface* surface, FrameStats* stats);
+
+    /// Blocks until the next frame should start, returns the time spent waiting in milliseconds
+    f64 waitForFrameStart();
+
+    void framePresented(const FrameTiming& timing);
+
+    /// Forgets presents of the current swapchain, call after recreating it
+    void reset();
+
+    inline void setEnabled(bool value) { enabled = value; }
+    [[nodiscard]] inline bool isEnabled() const { return enabled; }
+};
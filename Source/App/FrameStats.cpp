@@ -0,0 +1,70 @@
+#include "FrameStats.hpp"
+
+void FrameStats::record(const FrameTiming& timing) {
+    history[timing.frameIndex % HISTORY_SIZE] = timing;
+    frameCount++;
+}
+
+bool FrameStats::setLatency(u64 frameIndex, f64 latency) {
+    FrameTiming& t = history[frameIndex % HISTORY_SIZE];
+    if (t.frameIndex != frameIndex) return false;
+    if (t.present.received and t.present.presentTime != FrameClock::time_point{}) return true;
+    t.latency = latency;
+    return true;
+}
+
+bool FrameStats::setPresentTiming(u64 frameIndex, const PresentTiming& _present) {
+    PresentTiming present = _present;
+    present.received      = true;
+
+    if (present.discarded) {
+        discardedCount++;
+    } else if (present.sequence) {
+        if (lastSequence and present.sequence > lastSequence) {
+            present.refreshes = (u32)(present.sequence - lastSequence);
+            if (present.vsync) missedRefreshCount += present.refreshes - 1;
+        }
+        lastSequence = present.sequence;
+    }
+
+    FrameTiming& t = history[frameIndex % HISTORY_SIZE];
+    if (t.frameIndex != frameIndex) return false;
+    t.present = present;
+    if (!present.discarded and present.presentTime != FrameClock::time_point{})
+        t.latency = toMilliseconds(present.presentTime - t.start);
+    return true;
+}
+
+const FrameTiming* FrameStats::getFrame(u64 frameIndex) const {
+    const FrameTiming& t = history[frameIndex % HISTORY_SIZE];
+    return t.frameIndex == frameIndex ? &t : nullptr;
+}
+
+FrameTiming FrameStats::getAverage() const {
+    FrameTiming avg;
+    u32 count = 0, latencyCount = 0, refreshCount = 0;
+    for (const auto& t : history) {
+        if (t.frameIndex == 0) continue;
+        avg.paceWait      += t.paceWait;
+        avg.cpuTime       += t.cpuTime;
+        avg.frameInterval += t.frameInterval;
+        count++;
+        if (t.latency > 0.0) {
+            avg.latency += t.latency;
+            latencyCount++;
+        }
+        if (t.present.refreshInterval > 0.0) {
+            avg.present.refreshInterval += t.present.refreshInterval;
+            refreshCount++;
+        }
+    }
+
+    if (count) {
+        avg.paceWait      /= count;
+        avg.cpuTime       /= count;
+        avg.frameInterval /= count;
+    }
+    if (latencyCount) avg.latency /= latencyCount;
+    if (refreshCount) avg.present.refreshInterval /= refreshCount;
+    return avg;
+}
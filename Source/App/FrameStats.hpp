@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Core/Core.hpp"
+
+using FrameClock = std::chrono::steady_clock;
+
+inline f64 toMilliseconds(FrameClock::duration d) {
+    return std::chrono::duration<f64, std::milli>(d).count();
+}
+
+/// When and how the frame reached the screen, as reported by the compositor. Durations are in milliseconds.
+struct PresentTiming {
+    bool received  = false;  ///< Whether the compositor sent feedback, all other fields are unset otherwise
+    bool discarded = false;  ///< Replaced by a later frame before it was shown
+    FrameClock::time_point presentTime{};  ///< Epoch if the compositor uses a different clock
+    f64 refreshInterval = 0.0;             ///< 0 if unknown or the output has a variable refresh rate
+    u64 sequence        = 0;               ///< Refresh counter of the output, 0 if unknown
+    /// Refreshes since the previously shown frame, in vsync modes more than one means refreshes were missed
+    u32 refreshes = 0;
+    bool vsync    = false;  ///< Synchronized to the refresh, i.e. without tearing
+    bool zeroCopy = false;  ///< Scanned out directly, without a composition pass
+};
+
+/**
+ * @brief Timing of a single frame. Durations are in milliseconds.
+ */
+struct FrameTiming {
+    u64 frameIndex = 0;
+    FrameClock::time_point start{};  ///< When the CPU started the frame, input is sampled from here on
+    f64 paceWait      = 0.0;         ///< Time spent waiting for the frame start
+    f64 cpuTime       = 0.0;         ///< Time from frame start until the frame was queued for present
+    f64 frameInterval = 0.0;         ///< Time since the start of the previous frame
+    f64 latency       = 0.0;         ///< Time from frame start until the frame was displayed, 0 if unknown
+    PresentTiming present;
+};
+
+/**
+ * @brief Ring buffer of the timings of the most recent frames.
+ */
+class FrameStats {
+   public:
+    static constexpr u32 HISTORY_SIZE = 128;
+
+   private:
+    FrameTiming history[HISTORY_SIZE]{};
+    u64 frameCount = 0;
+
+    u64 lastSequence   = 0;  ///< Of the last shown frame, for PresentTiming::refreshes
+    u64 discardedCount = 0, missedRefreshCount = 0;
+
+   public:
+    FrameStats() = default;
+
+    void record(const FrameTiming& timing);
+
+    /**
+     * Latency is only known once the frame is displayed, returns false if the frame left the history. Ignored
+     * if the latency is already known from the present time of the compositor.
+     */
+    bool setLatency(u64 frameIndex, f64 latency);
+
+    /**
+     * @brief Stores presentation feedback of the compositor, which has to arrive in present order.
+     *
+     * Also sets the latency if the present time is known, the compositor knows better than a present wait.
+     * Returns false if the frame left the history, it still counts towards the discarded and missed counts.
+     */
+    bool setPresentTiming(u64 frameIndex, const PresentTiming& present);
+
+    /// Returns nullptr if the frame is not in the history
+    [[nodiscard]] const FrameTiming* getFrame(u64 frameIndex) const;
+
+    /// Average of the history, latency is only averaged over frames where it was measured
+    [[nodiscard]] FrameTiming getAverage() const;
+
+    [[nodiscard]] inline u64 getFrameCount() const { return frameCount; }
+    /// Frames the compositor reported as never shown, since creation
+    [[nodiscard]] inline u64 getDiscardedCount() const { return discardedCount; }
+    /// Refreshes skipped between consecutive shown frames with vsync, since creation, a measure of stutter
+    [[nodiscard]] inline u64 getMissedRefreshCount() const { return missedRefreshCount; }
+};
@@ -0,0 +1,35 @@
+#include "Event.hpp"
+
+#include <cstring>
+
+Event::Event(const CloseEvent& _close) : kind(EventKind::Close), close(_close) {}
+
+Event::Event(const ResizeEvent& _resize) : kind(EventKind::Resize), resize(_resize) {}
+
+Event::Event(const MouseMoveEvent& _mouseMove) : kind(EventKind::MouseMove), mouseMove(_mouseMove) {}
+
+Event::Event(const MouseRelativeMoveEvent& _mouseRelativeMove)
+    : kind(EventKind::MouseRelativeMove), mouseRelativeMove(_mouseRelativeMove) {}
+
+Event::Event(const MouseButtonPressedEvent& _mouseButtonPressed)
+    : kind(EventKind::MouseButtonPressed), mouseButtonPressed(_mouseButtonPressed) {}
+
+Event::Event(const MouseButtonReleasedEvent& _mouseButtonReleased)
+    : kind(EventKind::MouseButtonReleased), mouseButtonReleased(_mouseButtonReleased) {}
+
+Event::Event(const KeyPressedEvent& _keyPressed) : kind(EventKind::KeyPressed), keyPressed(_keyPressed) {}
+
+Event::Event(const KeyReleasedEvent& _keyReleased)
+    : kind(EventKind::KeyReleased), keyReleased(_keyReleased) {}
+
+Event::Event(const TextInputEvent& _textInput) : kind(EventKind::TextInput), textInput(_textInput) {}
+
+TextInputEvent::TextInputEvent(const char* _text) {
+    u64 length = std::strlen(_text);
+    if (length >= TEXT_INPUT_SIZE) {
+        length = TEXT_INPUT_SIZE - 1;
+        while (length > 0 and (_text[length] & 0xc0) == 0x80) length--;  // Inside a multi byte sequence
+    }
+    std::memcpy(text, _text, length);
+    text[length] = '\0';
+}
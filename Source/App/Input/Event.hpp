@@ -4,6 +4,9 @@
 #include "Keyboard.hpp"
 #include "Mouse.hpp"
 
+/// The user asked to close the window
+class CloseEvent {};
+
 class ResizeEvent {
    public:
     u32 width, height;
@@ -19,6 +22,27 @@ class MouseMoveEvent {
     inline MouseMoveEvent(i32 _x, i32 _y, i32 _dx, i32 _dy) : x(_x), y(_y), dx(_dx), dy(_dy) {}
 };
 
+/**
+ * @brief Unclipped pointer motion straight from the device, also sent while the pointer is confined or at the
+ * edge of the screen.
+ *
+ * The unaccelerated deltas are in device units, the accelerated ones in the same units as MouseMoveEvent.
+ */
+class MouseRelativeMoveEvent {
+   public:
+    f32 dx, dy;
+    f32 dxUnaccelerated, dyUnaccelerated;
+
+    inline MouseRelativeMoveEvent(f32 _dx, f32 _dy, f32 _dxUnaccelerated, f32 _dyUnaccelerated)
+        : dx(_dx), dy(_dy), dxUnaccelerated(_dxUnaccelerated), dyUnaccelerated(_dyUnaccelerated) {}
+};
+
+/// Pointer position as reported by the windowing system, kept between frames when motion history is enabled
+struct MotionSample {
+    f32 x, y;
+    u64 time;  ///< Microseconds, in the clock of the windowing system
+};
+
 class MouseButtonPressedEvent {
    public:
     MouseButton button;
@@ -37,8 +61,10 @@ class KeyPressedEvent {
    public:
     Key key;
     Modifiers modifiers;
+    bool repeat;  ///< Sent again while the key is held, without a release in between
 
-    inline KeyPressedEvent(Key _key, Modifiers _modifiers) : key(_key), modifiers(_modifiers) {}
+    inline KeyPressedEvent(Key _key, Modifiers _modifiers, bool _repeat = false)
+        : key(_key), modifiers(_modifiers), repeat(_repeat) {}
 };
 
 class KeyReleasedEvent {
@@ -49,6 +75,66 @@ class KeyReleasedEvent {
     inline KeyReleasedEvent(Key _key, Modifiers _modifiers) : key(_key), modifiers(_modifiers) {}
 };
 
+/// Bytes of UTF-8 a TextInputEvent can hold, including the terminator
+const u32 TEXT_INPUT_SIZE = 16;
+
+/**
+ * @brief Text typed by the user, after the keyboard layout, dead keys and compose sequences are applied.
+ *
+ * Sent after the KeyPressedEvent of the key that finished the text, also when the key repeats. Keys that only
+ * produce control characters, like Enter or Ctrl+C, send no text.
+ */
+class TextInputEvent {
+   public:
+    char text[TEXT_INPUT_SIZE];  ///< Null terminated UTF-8
+
+    /// Longer text is cut at the last whole code point that fits
+    explicit TextInputEvent(const char* text);
+};
+
+enum class EventKind : u8 {
+    Close,
+    Resize,
+    MouseMove,
+    MouseRelativeMove,
+    MouseButtonPressed,
+    MouseButtonReleased,
+    KeyPressed,
+    KeyReleased,
+    TextInput,
+};
+
+/**
+ * @brief Any window event, stored by value so events can be queued without allocations or type erasure.
+ */
+class Event {
+   public:
+    Event() = delete;
+    Event(const CloseEvent& close);
+    Event(const ResizeEvent& resize);
+    Event(const MouseMoveEvent& mouseMove);
+    Event(const MouseRelativeMoveEvent& mouseRelativeMove);
+    Event(const MouseButtonPressedEvent& mouseButtonPressed);
+    Event(const MouseButtonReleasedEvent& mouseButtonReleased);
+    Event(const KeyPressedEvent& keyPressed);
+    Event(const KeyReleasedEvent& keyReleased);
+    Event(const TextInputEvent& textInput);
+
+    EventKind kind;
+
+    union {
+        CloseEvent close;
+        ResizeEvent resize;
+        MouseMoveEvent mouseMove;
+        MouseRelativeMoveEvent mouseRelativeMove;
+        MouseButtonPressedEvent mouseButtonPressed;
+        MouseButtonReleasedEvent mouseButtonReleased;
+        KeyPressedEvent keyPressed;
+        KeyReleasedEvent keyReleased;
+        TextInputEvent textInput;
+    };
+};
+
 template <>
 struct std::formatter<ResizeEvent> : std::formatter<String> {
     auto format(const ResizeEvent& e, auto& ctx) const {
@@ -62,6 +148,17 @@ struct std::formatter<MouseMoveEvent> : std::formatter<String> {
     }
 };
 template <>
+struct std::formatter<MouseRelativeMoveEvent> : std::formatter<String> {
+    auto format(const MouseRelativeMoveEvent& e, auto& ctx) const {
+        return std::format_to(ctx.out(),
+                              "MouseRelativeMove(dx: {}, dy: {}, dxUnaccelerated: {}, dyUnaccelerated: {})",
+                              e.dx,
+                              e.dy,
+                              e.dxUnaccelerated,
+                              e.dyUnaccelerated);
+    }
+};
+template <>
 struct std::formatter<MouseButtonPressedEvent> : std::formatter<String> {
     auto format(const MouseButtonPressedEvent& e, auto& ctx) const {
         return std::format_to(ctx.out(), "MouseButtonPressed({})", e.button);
@@ -76,7 +173,8 @@ struct std::formatter<MouseButtonReleasedEvent> : std::formatter<String> {
 template <>
 struct std::formatter<KeyPressedEvent> : std::formatter<String> {
     auto format(const KeyPressedEvent& e, auto& ctx) const {
-        return std::format_to(ctx.out(), "KeyPressed(key: {}, modifiers: {})", e.key, e.modifiers);
+        return std::format_to(
+            ctx.out(), "KeyPressed(key: {}, modifiers: {}, repeat: {})", e.key, e.modifiers, e.repeat);
     }
 };
 template <>
@@ -85,3 +183,9 @@ struct std::formatter<KeyReleasedEvent> : std::formatter<String> {
         return std::format_to(ctx.out(), "KeyReleased(key: {}, modifiers: {})", e.key, e.modifiers);
     }
 };
+template <>
+struct std::formatter<TextInputEvent> : std::formatter<String> {
+    auto format(const TextInputEvent& e, auto& ctx) const {
+        return std::format_to(ctx.out(), "TextInput(\"{}\")", e.text);
+    }
+};
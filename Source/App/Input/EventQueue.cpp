@@ -0,0 +1,79 @@
+#include "EventQueue.hpp"
+
+void EventQueue::push(const Event& event) {
+    std::lock_guard lock(mutex);
+
+    if (event.kind == EventKind::Resize and pendingResize != NONE) {  // Only the last size matters
+        events[pendingResize].resize = event.resize;
+        return;
+    }
+
+    if (events.getSize() > 0) {
+        Event& last = events[events.getSize() - 1];
+        if (event.kind == EventKind::MouseMove and last.kind == EventKind::MouseMove) {
+            last.mouseMove.x = event.mouseMove.x, last.mouseMove.y = event.mouseMove.y;
+            last.mouseMove.dx += event.mouseMove.dx, last.mouseMove.dy += event.mouseMove.dy;
+            return;
+        }
+        if (event.kind == EventKind::MouseRelativeMove and last.kind == EventKind::MouseRelativeMove) {
+            last.mouseRelativeMove.dx              += event.mouseRelativeMove.dx;
+            last.mouseRelativeMove.dy              += event.mouseRelativeMove.dy;
+            last.mouseRelativeMove.dxUnaccelerated += event.mouseRelativeMove.dxUnaccelerated;
+            last.mouseRelativeMove.dyUnaccelerated += event.mouseRelativeMove.dyUnaccelerated;
+            return;
+        }
+    }
+
+    if (event.kind == EventKind::Resize) pendingResize = events.getSize();
+    events.push(event);
+}
+
+void EventQueue::pushMotionSample(const MotionSample& sample) {
+    std::lock_guard lock(mutex);
+    if (!motionHistory) return;
+
+    if (samples.getSize() < MAX_MOTION_SAMPLES) {
+        samples.push(sample);
+    } else {
+        samples[firstSample] = sample;
+        firstSample          = (firstSample + 1) % MAX_MOTION_SAMPLES;
+    }
+}
+
+void EventQueue::setMotionHistory(bool enabled) {
+    std::lock_guard lock(mutex);
+    motionHistory = enabled;
+    if (!enabled) samples.clear(), firstSample = 0;
+}
+
+void EventQueue::poll(Vec<Event>& _events) {
+    _events.clear();
+
+    std::lock_guard lock(mutex);
+    std::swap(events, _events);
+    pendingResize = NONE;
+}
+
+void EventQueue::poll(Vec<Event>& _events, Vec<MotionSample>& _samples) {
+    _events.clear();
+    _samples.clear();
+
+    std::lock_guard lock(mutex);
+    std::swap(events, _events);
+    pendingResize = NONE;
+
+    if (firstSample == 0) {
+        std::swap(samples, _samples);
+    } else {  // Wrapped, unroll the ring so the caller gets the samples in order
+        for (u64 i = 0; i < samples.getSize(); i++) {
+            _samples.push(samples[(firstSample + i) % samples.getSize()]);
+        }
+        samples.clear();
+        firstSample = 0;
+    }
+}
+
+bool EventQueue::hasEvents() {
+    std::lock_guard lock(mutex);
+    return events.getSize() > 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <mutex>
+
+#include "Core/Core.hpp"
+#include "Event.hpp"
+
+/**
+ * @brief Events of one window, filled while the window connection dispatches and drained once per frame.
+ *
+ * Pushing coalesces high rate events: a resize replaces the one still pending, and consecutive motion events
+ * merge into one with the latest position and the summed deltas. Events can be pushed and polled from
+ * different threads.
+ *
+ * With motion history enabled, every position is also kept as a timestamped sample, so widgets that draw or
+ * plot the pointer path don't lose the points between frames. The history of one frame is capped at
+ * MAX_MOTION_SAMPLES, dropping the oldest samples, so a flood of input can't grow it without bound.
+ */
+class EventQueue {
+   public:
+    static constexpr u64 MAX_MOTION_SAMPLES = 4096;
+
+   private:
+    static constexpr u64 NONE = UINT64_MAX;
+
+    std::mutex mutex;
+    Vec<Event> events;
+    u64 pendingResize = NONE;  ///< Index of the resize event in events
+
+    bool motionHistory = false;
+    Vec<MotionSample> samples;
+    u64 firstSample = 0;  ///< Oldest sample once samples is full, samples is a ring buffer from then on
+
+   public:
+    void push(const Event& event);
+
+    /// Ignored unless motion history is enabled
+    void pushMotionSample(const MotionSample& sample);
+
+    /// Disabling drops the samples not polled yet
+    void setMotionHistory(bool enabled);
+
+    /**
+     * @brief Moves the pending events into events, in the order they were pushed.
+     *
+     * The previous content of events is dropped, passing the same Vec every frame reuses its memory.
+     */
+    void poll(Vec<Event>& events);
+
+    /// Same as poll(events), and moves the motion samples into samples, oldest first
+    void poll(Vec<Event>& events, Vec<MotionSample>& samples);
+
+    /// Whether events were pushed since the last poll, can be called from any thread
+    [[nodiscard]] bool hasEvents();
+};
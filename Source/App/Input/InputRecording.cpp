@@ -0,0 +1,145 @@
+#include "InputRecording.hpp"
+
+#include <cstring>
+
+#include "../Window/HeadlessWindow.hpp"
+
+template <typename T>
+static void write(Vec<u8>& buffer, const T& value) {
+    u64 offset = buffer.getSize();
+    buffer.resize(offset + sizeof(T));
+    std::memcpy(buffer.getData() + offset, &value, sizeof(T));
+}
+
+template <typename T>
+static T read(const u8*& pos, const u8* end) {
+    if ((u64)(end - pos) < sizeof(T)) throw std::runtime_error("Input recording is truncated");
+    T value;
+    std::memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return value;
+}
+
+/*****************
+ * InputRecorder *
+ *****************/
+
+InputRecorder::InputRecorder(const char* path) : file(path, std::ios::binary | std::ios::trunc) {
+    if (!file) throw std::runtime_error(std::format("Failed to open file: {}", path));
+
+    write(buffer, MAGIC);
+    write(buffer, VERSION);
+    file.write((const char*)buffer.getData(), (i64)buffer.getSize());
+
+    start = std::chrono::steady_clock::now();
+}
+
+void InputRecorder::record(const Vec<Event>& events) {
+    u32 index = frameIndex++;
+    if (events.getSize() == 0) return;
+
+    auto time =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    buffer.clear();
+    write(buffer, (u64)time.count());
+    write(buffer, index);
+    write(buffer, (u32)events.getSize());
+    for (const Event& e : events) {
+        write(buffer, e.kind);
+        // All members share the address of the union, and are trivially copyable
+        u64 size   = getPayloadSize(e.kind);
+        u64 offset = buffer.getSize();
+        buffer.resize(offset + size);
+        std::memcpy(buffer.getData() + offset, &e.close, size);
+    }
+    file.write((const char*)buffer.getData(), (i64)buffer.getSize());
+}
+
+void InputRecorder::flush() { file.flush(); }
+
+u64 InputRecorder::getPayloadSize(EventKind kind) {
+    switch (kind) {
+        case EventKind::Close: return 0;
+        case EventKind::Resize: return sizeof(ResizeEvent);
+        case EventKind::MouseMove: return sizeof(MouseMoveEvent);
+        case EventKind::MouseRelativeMove: return sizeof(MouseRelativeMoveEvent);
+        case EventKind::MouseButtonPressed: return sizeof(MouseButtonPressedEvent);
+        case EventKind::MouseButtonReleased: return sizeof(MouseButtonReleasedEvent);
+        case EventKind::KeyPressed: return sizeof(KeyPressedEvent);
+        case EventKind::KeyReleased: return sizeof(KeyReleasedEvent);
+        case EventKind::TextInput: return sizeof(TextInputEvent);
+    }
+    throw std::runtime_error("Invalid event kind in input recording");
+}
+
+/*****************
+ * InputReplayer *
+ *****************/
+
+InputReplayer::InputReplayer(const char* path, ReplaySpeed _speed) : speed(_speed) {
+    std::ifstream f(path, std::ios::ate | std::ios::binary);
+    if (!f) throw std::runtime_error(std::format("Failed to open file: {}", path));
+    u64 size = f.tellg();
+    Vec<u8> data(size);
+    f.seekg(0);
+    f.read((char*)data.getData(), (i64)size);
+    f.close();
+
+    const u8* pos = data.getData();
+    const u8* end = pos + size;
+    if (read<u32>(pos, end) != InputRecorder::MAGIC) throw std::runtime_error("Not an input recording");
+    if (read<u32>(pos, end) != InputRecorder::VERSION)
+        throw std::runtime_error("Unsupported input recording version");
+
+    while (pos != end) {
+        Frame frame{};
+        frame.time       = read<u64>(pos, end);
+        frame.index      = read<u32>(pos, end);
+        frame.eventCount = read<u32>(pos, end);
+        frame.firstEvent = (u32)events.getSize();
+
+        for (u32 i = 0; i < frame.eventCount; i++) {
+            Event e(CloseEvent{});
+            e.kind = read<EventKind>(pos, end);
+
+            u64 payload = InputRecorder::getPayloadSize(e.kind);
+            if ((u64)(end - pos) < payload) throw std::runtime_error("Input recording is truncated");
+            std::memcpy(&e.close, pos, payload);
+            pos += payload;
+
+            events.push(e);
+        }
+        frames.push(frame);
+    }
+}
+
+bool InputReplayer::update(HeadlessWindow* window) {
+    if (!started) {
+        start   = std::chrono::steady_clock::now();
+        started = true;
+    }
+
+    if (speed == ReplaySpeed::Max) {
+        if (nextFrame < frames.getSize() and frames[nextFrame].index == frameIndex) {
+            const Frame& frame = frames[nextFrame++];
+            for (u32 i = 0; i < frame.eventCount; i++) window->inject(events[frame.firstEvent + i]);
+        }
+        frameIndex++;
+    } else {
+        auto elapsed =
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        while (nextFrame < frames.getSize() and frames[nextFrame].time <= (u64)elapsed.count()) {
+            const Frame& frame = frames[nextFrame++];
+            for (u32 i = 0; i < frame.eventCount; i++) window->inject(events[frame.firstEvent + i]);
+        }
+    }
+
+    return !isFinished();
+}
+
+void InputReplayer::restart() {
+    nextFrame  = 0;
+    frameIndex = 0;
+    started    = false;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+#include <fstream>
+
+#include "Core/Core.hpp"
+#include "Event.hpp"
+
+class HeadlessWindow;
+
+/**
+ * @brief Writes the events a window delivers to a compact binary log, to replay user sessions in benchmarks.
+ *
+ * Events are recorded as returned by Window::pollEvents, after coalescing, together with the index of the
+ * poll they were returned by and the time since recording started. Frames without events are skipped.
+ *
+ * The log is written in host byte order and only meant to be replayed by the same build on the same
+ * architecture:
+ *     header: magic "XVIN", u32 version
+ *     frame:  u64 time in microseconds, u32 frame index, u32 event count, then per event its u8 kind
+ *             followed by the bytes of the matching Event member
+ */
+class InputRecorder {
+   public:
+    static constexpr u32 MAGIC   = 'X' | 'V' << 8 | 'I' << 16 | 'N' << 24;
+    static constexpr u32 VERSION = 2;  ///< 2 added key repeat and text input
+
+   private:
+    std::ofstream file;
+    std::chrono::steady_clock::time_point start;
+    u32 frameIndex = 0;
+    Vec<u8> buffer;  ///< Reused for every frame, so a frame is written with one call
+
+   public:
+    explicit InputRecorder(const char* path);
+
+    InputRecorder(const InputRecorder&)            = delete;
+    InputRecorder& operator=(const InputRecorder&) = delete;
+
+    /// Records the events of one frame, called by Window::pollEvents
+    void record(const Vec<Event>& events);
+
+    /// Writes buffered data to the file, also done on destruction
+    void flush();
+
+    /// Size of the bytes of the member of Event that holds an event of the given kind
+    static u64 getPayloadSize(EventKind kind);
+};
+
+enum class ReplaySpeed : u8 {
+    Recorded,  ///< Events are injected when as much time passed since the first update as during recording
+    Max,       ///< Updates count polls, a recorded frame is injected by the update of its poll index
+};
+
+/**
+ * @brief Drives a HeadlessWindow with a log written by InputRecorder.
+ *
+ * Replays at maximum speed are deterministic: update is meant to be called once per frame before the window
+ * is polled, and the events of recorded frame n are returned by the n-th poll. Polls that returned no events
+ * during recording inject nothing. See HeadlessWindow for what can be driven this way.
+ */
+class InputReplayer {
+   private:
+    struct Frame {
+        u64 time;
+        u32 index;
+        u32 firstEvent, eventCount;
+    };
+
+    Vec<Frame> frames;
+    Vec<Event> events;
+
+    ReplaySpeed speed;
+    u64 nextFrame  = 0;
+    u32 frameIndex = 0;
+    bool started   = false;
+    std::chrono::steady_clock::time_point start;
+
+   public:
+    /// Throws if the file can't be read or wasn't written by a compatible InputRecorder
+    InputReplayer(const char* path, ReplaySpeed speed);
+
+    /**
+     * @brief Injects the events that are due into window.
+     *
+     * @return False once every recorded event was injected.
+     */
+    bool update(HeadlessWindow* window);
+
+    /// Starts from the first frame again
+    void restart();
+
+    [[nodiscard]] inline u64 getFrameCount() const { return frames.getSize(); }
+    [[nodiscard]] inline u64 getEventCount() const { return events.getSize(); }
+    [[nodiscard]] inline bool isFinished() const { return nextFrame == frames.getSize(); }
+};
@@ -98,5 +98,43 @@ const char* keyToString(Key key) {
         case Key::F10: return "F10";
         case Key::F11: return "F11";
         case Key::F12: return "F12";
+        case Key::F13: return "F13";
+        case Key::F14: return "F14";
+        case Key::F15: return "F15";
+        case Key::F16: return "F16";
+        case Key::F17: return "F17";
+        case Key::F18: return "F18";
+        case Key::F19: return "F19";
+        case Key::F20: return "F20";
+        case Key::F21: return "F21";
+        case Key::F22: return "F22";
+        case Key::F23: return "F23";
+        case Key::F24: return "F24";
+        case Key::NumLock: return "NumLock";
+        case Key::KP0: return "KP0";
+        case Key::KP1: return "KP1";
+        case Key::KP2: return "KP2";
+        case Key::KP3: return "KP3";
+        case Key::KP4: return "KP4";
+        case Key::KP5: return "KP5";
+        case Key::KP6: return "KP6";
+        case Key::KP7: return "KP7";
+        case Key::KP8: return "KP8";
+        case Key::KP9: return "KP9";
+        case Key::KPDecimal: return "KPDecimal";
+        case Key::KPDivide: return "KPDivide";
+        case Key::KPMultiply: return "KPMultiply";
+        case Key::KPSubtract: return "KPSubtract";
+        case Key::KPAdd: return "KPAdd";
+        case Key::KPEnter: return "KPEnter";
+        case Key::KPEquals: return "KPEquals";
+        case Key::MediaPlay: return "MediaPlay";
+        case Key::MediaPause: return "MediaPause";
+        case Key::MediaStop: return "MediaStop";
+        case Key::MediaNext: return "MediaNext";
+        case Key::MediaPrevious: return "MediaPrevious";
+        case Key::VolumeMute: return "VolumeMute";
+        case Key::VolumeDown: return "VolumeDown";
+        case Key::VolumeUp: return "VolumeUp";
     }
 }
\ No newline at end of file
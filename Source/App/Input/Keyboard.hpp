@@ -156,6 +156,48 @@ enum class Key : u32 {
     F10,
     F11,
     F12,
+    F13,
+    F14,
+    F15,
+    F16,
+    F17,
+    F18,
+    F19,
+    F20,
+    F21,
+    F22,
+    F23,
+    F24,
+
+    // Keypad, the digits are reported as such whether NumLock is on or not
+    NumLock,
+    KP0,
+    KP1,
+    KP2,
+    KP3,
+    KP4,
+    KP5,
+    KP6,
+    KP7,
+    KP8,
+    KP9,
+    KPDecimal,
+    KPDivide,
+    KPMultiply,
+    KPSubtract,
+    KPAdd,
+    KPEnter,
+    KPEquals,
+
+    // Media
+    MediaPlay,
+    MediaPause,
+    MediaStop,
+    MediaNext,
+    MediaPrevious,
+    VolumeMute,
+    VolumeDown,
+    VolumeUp,
     KEY_COUNT,
 };
 
@@ -0,0 +1,45 @@
+#include "StartupTrace.hpp"
+
+#include <algorithm>
+
+// Initialized before main
+static const FrameClock::time_point processStart = FrameClock::now();
+
+StartupTrace::Scope::Scope(StartupTrace* _trace, const char* _name, u32 _thread)
+    : trace(_trace), name(_name), thread(_thread), start(FrameClock::now()) {}
+
+StartupTrace::Scope::~Scope() { trace->record(name, start, FrameClock::now(), thread); }
+
+void StartupTrace::record(const char* name, FrameClock::time_point start, FrameClock::time_point end,
+                          u32 thread) {
+    std::lock_guard lock(mutex);
+    if (!finished) spans.push({.name = name, .start = start, .end = end, .thread = thread});
+}
+
+bool StartupTrace::finish() {
+    std::lock_guard lock(mutex);
+    if (finished) return false;
+    firstFrame = FrameClock::now();
+    finished   = true;
+    return true;
+}
+
+f64 StartupTrace::getTimeToFirstFrame() {
+    std::lock_guard lock(mutex);
+    return finished ? toMilliseconds(firstFrame - processStart) : 0.0;
+}
+
+void StartupTrace::print() {
+    std::lock_guard lock(mutex);
+    std::sort(spans.getData(), spans.getData() + spans.getSize(),
+              [](const Span& a, const Span& b) { return a.start < b.start; });
+
+    println("Startup trace, start and duration in ms:");
+    for (const Span& s : spans) {
+        println("  {:>8.2f} {:>8.2f}  thread {:<2} {}", toMilliseconds(s.start - processStart),
+                toMilliseconds(s.end - s.start), s.thread, s.name);
+    }
+    if (finished) println("  First frame after {:.2f}", toMilliseconds(firstFrame - processStart));
+}
+
+FrameClock::time_point StartupTrace::getProcessStart() { return processStart; }
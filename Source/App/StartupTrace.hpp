@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include "Core/Core.hpp"
+#include "FrameStats.hpp"
+
+/**
+ * @brief Records how long the steps of engine startup took and on which thread, up to the first frame.
+ *
+ * Times are relative to the static initialization of the engine, which is close enough to the start of the
+ * process to tell what the time to the first frame is spent on. Recording is thread safe, steps run as jobs
+ * pass the index of the job system thread they run on.
+ */
+class StartupTrace {
+   public:
+    struct Span {
+        const char* name;
+        FrameClock::time_point start;
+        FrameClock::time_point end;
+        u32 thread;  ///< Index of the job system thread, 0 for any other thread
+    };
+
+    /// Records the span of its lifetime
+    class Scope {
+       private:
+        StartupTrace* trace;
+        const char* name;
+        u32 thread;
+        FrameClock::time_point start;
+
+       public:
+        Scope(StartupTrace* trace, const char* name, u32 thread = 0);
+        ~Scope();
+
+        Scope(const Scope&)            = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+   private:
+    std::mutex mutex;
+    Vec<Span> spans;
+    FrameClock::time_point firstFrame{};
+    std::atomic<bool> finished = false;
+
+   public:
+    /// Ignored once the trace is finished
+    void record(const char* name, FrameClock::time_point start, FrameClock::time_point end, u32 thread = 0);
+
+    /// Ends the trace once the first frame was presented, returns false if it already ended
+    bool finish();
+    [[nodiscard]] inline bool isFinished() const { return finished; }
+
+    /// Milliseconds from process start to the first frame, 0 if there wasn't one yet
+    [[nodiscard]] f64 getTimeToFirstFrame();
+
+    /// Prints every span in start order, followed by the time to the first frame
+    void print();
+
+    /// Close to when the process started, what the spans are reported relative to
+    static FrameClock::time_point getProcessStart();
+};
@@ -0,0 +1,19 @@
+#include "HeadlessWindow.hpp"
+
+HeadlessWindow::HeadlessWindow(u32 _width, u32 _height) : width(_width), height(_height) {}
+
+void HeadlessWindow::inject(const Event& event) {
+    if (event.kind == EventKind::Resize) width = event.resize.width, height = event.resize.height;
+    pushEvent(event);
+}
+
+void HeadlessWindow::show() { visible = true; }
+void HeadlessWindow::hide() { visible = false; }
+
+void HeadlessWindow::minimize() {}
+void HeadlessWindow::setMaximized(bool) {}
+void HeadlessWindow::setFullscreen(bool) {}
+
+void HeadlessWindow::resize(u32 _width, u32 _height) { inject(ResizeEvent(_width, _height)); }
+
+void HeadlessWindow::setTitle(const String& _title) { title = _title; }
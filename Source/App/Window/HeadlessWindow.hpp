@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Window.hpp"
+
+/**
+ * @brief Window without a windowing system behind it, fed with events by the caller.
+ *
+ * Replayed input is read back with pollEvents by whatever consumes window events, without a display to
+ * connect to. It has nothing to present to: App and AppWindow only create windows through the
+ * WindowConnection and always render to a Surface, which a headless device can't create, so a whole App
+ * can't run on it. Resize events update the size it reports, everything else only goes through the event
+ * queue like on a real window.
+ */
+class HeadlessWindow : public Window {
+   private:
+    u32 width, height;
+    bool visible = true;
+    String title;
+
+   public:
+    HeadlessWindow(u32 width, u32 height);
+
+    /// Queues an event as if the windowing system had sent it
+    void inject(const Event& event);
+
+    void show() override;
+    void hide() override;
+
+    void minimize() override;
+    void setMaximized(bool value) override;
+    void setFullscreen(bool value) override;
+    void resize(u32 width, u32 height) override;
+    void setTitle(const String& title) override;
+
+    inline u32 getWidth() override { return width; }
+    inline u32 getHeight() override { return height; }
+
+    [[nodiscard]] inline bool isVisible() const { return visible; }
+    [[nodiscard]] inline const String& getTitle() const { return title; }
+};
@@ -1,81 +1,185 @@
 #include "LinuxCommon.hpp"
 
+#include <array>
+#include <cstdlib>
 #include <xkbcommon/xkbcommon.h>
 
 #include <Core/Core.hpp>
 
-// I don't know how efficient this is, but seems better that a switch statement
-const u32 KEY_MAP_MAX = 512;
-bool keymapInit       = false;
-Vec<Key> KEYMAP(KEY_MAP_MAX, Key::Unknown);
-void initKeyMap() {
-    // First part
-    KEYMAP[XKB_KEY_space]      = Key::Space;
-    KEYMAP[XKB_KEY_apostrophe] = Key::Apostrophe;
-    KEYMAP[XKB_KEY_comma]      = Key::Comma;
-    KEYMAP[XKB_KEY_minus]      = Key::Minus;
-    KEYMAP[XKB_KEY_period]     = Key::Period;
-    KEYMAP[XKB_KEY_slash]      = Key::Slash;
-    for (int i = XKB_KEY_0, i2 = (i32)Key::Num0; i <= XKB_KEY_9 and i2 <= (i32)Key::Num9; i++, i2++)
-        KEYMAP[i] = (Key)i2;
-    KEYMAP[XKB_KEY_semicolon] = Key::Semicolon;
-    KEYMAP[XKB_KEY_equal]     = Key::Equals;
-    for (int i = XKB_KEY_A, i2 = (i32)Key::A; i <= XKB_KEY_Z and i2 <= (i32)Key::Z; i++, i2++)
-        KEYMAP[i] = (Key)i2;
-    KEYMAP[XKB_KEY_bracketleft]  = Key::LBracket;
-    KEYMAP[XKB_KEY_backslash]    = Key::Backslash;
-    KEYMAP[XKB_KEY_bracketright] = Key::RBracket;
-    KEYMAP[XKB_KEY_grave]        = Key::Grave;
-    for (int i = XKB_KEY_a, i2 = (i32)Key::A; i <= XKB_KEY_z and i2 <= (i32)Key::Z; i++, i2++)
-        KEYMAP[i] = (Key)i2;
-
-    // Second part, starts at 0xff00, so we place it at 0x100
-    KEYMAP[XKB_KEY_BackSpace - 0xfe00]   = Key::Backspace;
-    KEYMAP[XKB_KEY_Tab - 0xfe00]         = Key::Tab;
-    KEYMAP[XKB_KEY_Return - 0xfe00]      = Key::Enter;
-    KEYMAP[XKB_KEY_Pause - 0xfe00]       = Key::Pause;
-    KEYMAP[XKB_KEY_Scroll_Lock - 0xfe00] = Key::ScrollLock;
-    KEYMAP[XKB_KEY_Sys_Req - 0xfe00]     = Key::Print;
-    KEYMAP[XKB_KEY_Escape - 0xfe00]      = Key::Escape;
-    KEYMAP[XKB_KEY_Delete - 0xfe00]      = Key::Delete;
-    KEYMAP[XKB_KEY_Home - 0xfe00]        = Key::Home;
-    KEYMAP[XKB_KEY_Left - 0xfe00]        = Key::Left;
-    KEYMAP[XKB_KEY_Up - 0xfe00]          = Key::Up;
-    KEYMAP[XKB_KEY_Right - 0xfe00]       = Key::Right;
-    KEYMAP[XKB_KEY_Down - 0xfe00]        = Key::Down;
-    KEYMAP[XKB_KEY_Page_Up - 0xfe00]     = Key::PageUp;
-    KEYMAP[XKB_KEY_Page_Down - 0xfe00]   = Key::PageDown;
-    KEYMAP[XKB_KEY_End - 0xfe00]         = Key::End;
-    KEYMAP[XKB_KEY_Insert - 0xfe00]      = Key::Insert;
-    KEYMAP[XKB_KEY_Menu - 0xfe00]        = Key::Menu;
-    KEYMAP[XKB_KEY_F1 - 0xfe00]          = Key::F1;
-    KEYMAP[XKB_KEY_F2 - 0xfe00]          = Key::F2;
-    KEYMAP[XKB_KEY_F3 - 0xfe00]          = Key::F3;
-    KEYMAP[XKB_KEY_F4 - 0xfe00]          = Key::F4;
-    KEYMAP[XKB_KEY_F5 - 0xfe00]          = Key::F5;
-    KEYMAP[XKB_KEY_F6 - 0xfe00]          = Key::F6;
-    KEYMAP[XKB_KEY_F7 - 0xfe00]          = Key::F7;
-    KEYMAP[XKB_KEY_F8 - 0xfe00]          = Key::F8;
-    KEYMAP[XKB_KEY_F9 - 0xfe00]          = Key::F9;
-    KEYMAP[XKB_KEY_F10 - 0xfe00]         = Key::F10;
-    KEYMAP[XKB_KEY_F11 - 0xfe00]         = Key::F11;
-    KEYMAP[XKB_KEY_F12 - 0xfe00]         = Key::F12;
-    KEYMAP[XKB_KEY_Shift_L - 0xfe00]     = Key::LShift;
-    KEYMAP[XKB_KEY_Shift_R - 0xfe00]     = Key::RShift;
-    KEYMAP[XKB_KEY_Control_L - 0xfe00]   = Key::LCtrl;
-    KEYMAP[XKB_KEY_Control_R - 0xfe00]   = Key::RCtrl;
-    KEYMAP[XKB_KEY_Caps_Lock - 0xfe00]   = Key::CapsLock;
-    KEYMAP[XKB_KEY_Alt_L - 0xfe00]       = Key::LAlt;
-    KEYMAP[XKB_KEY_Alt_R - 0xfe00]       = Key::RAlt;
-    KEYMAP[XKB_KEY_Super_L - 0xfe00]     = Key::Super;
-
-    keymapInit = true;
+// Every keysym that maps to a key is in one of a few pages of 256 keysyms, which are laid out one after
+// another in a table built at compile time. Any other keysym lands in the empty last page
+const u32 PAGE_SIZE  = 256;
+const u32 PAGE_COUNT = 5;
+
+using KeysymTable = std::array<u8, PAGE_COUNT * PAGE_SIZE>;
+static_assert((u32)Key::KEY_COUNT <= 256, "Keys are stored as bytes");
+
+// Conditional moves instead of a lookup or a switch
+static constexpr u32 getPage(u32 keysym) {
+    u32 high = keysym >> 8;
+    return high == 0x00 ? 0 : high == 0xfe ? 1 : high == 0xff ? 2 : high == 0x1008ff ? 3 : 4;
+}
+
+static constexpr u32 getIndex(u32 keysym) { return getPage(keysym) * PAGE_SIZE + (keysym & 0xff); }
+
+static constexpr void setRange(KeysymTable& table, u32 first, u32 last, Key firstKey) {
+    for (u32 keysym = first; keysym <= last; keysym++)
+        table[getIndex(keysym)] = (u8)((u32)firstKey + keysym - first);
+}
+
+static constexpr KeysymTable createKeysymTable() {
+    KeysymTable table{};
+    auto set = [&](u32 keysym, Key key) { table[getIndex(keysym)] = (u8)key; };
+
+    // Latin 1
+    set(XKB_KEY_space, Key::Space);
+    set(XKB_KEY_apostrophe, Key::Apostrophe);
+    set(XKB_KEY_comma, Key::Comma);
+    set(XKB_KEY_minus, Key::Minus);
+    set(XKB_KEY_period, Key::Period);
+    set(XKB_KEY_slash, Key::Slash);
+    setRange(table, XKB_KEY_0, XKB_KEY_9, Key::Num0);
+    set(XKB_KEY_semicolon, Key::Semicolon);
+    set(XKB_KEY_equal, Key::Equals);
+    setRange(table, XKB_KEY_A, XKB_KEY_Z, Key::A);
+    set(XKB_KEY_bracketleft, Key::LBracket);
+    set(XKB_KEY_backslash, Key::Backslash);
+    set(XKB_KEY_bracketright, Key::RBracket);
+    set(XKB_KEY_grave, Key::Grave);
+    setRange(table, XKB_KEY_a, XKB_KEY_z, Key::A);
+
+    // ISO, shift tab and AltGr on layouts that have it
+    set(XKB_KEY_ISO_Left_Tab, Key::Tab);
+    set(XKB_KEY_ISO_Level3_Shift, Key::RAlt);
+
+    // Control keys
+    set(XKB_KEY_BackSpace, Key::Backspace);
+    set(XKB_KEY_Tab, Key::Tab);
+    set(XKB_KEY_Return, Key::Enter);
+    set(XKB_KEY_Pause, Key::Pause);
+    set(XKB_KEY_Break, Key::Pause);
+    set(XKB_KEY_Scroll_Lock, Key::ScrollLock);
+    set(XKB_KEY_Sys_Req, Key::Print);
+    set(XKB_KEY_Print, Key::Print);
+    set(XKB_KEY_Escape, Key::Escape);
+    set(XKB_KEY_Delete, Key::Delete);
+    set(XKB_KEY_Home, Key::Home);
+    set(XKB_KEY_Left, Key::Left);
+    set(XKB_KEY_Up, Key::Up);
+    set(XKB_KEY_Right, Key::Right);
+    set(XKB_KEY_Down, Key::Down);
+    set(XKB_KEY_Page_Up, Key::PageUp);
+    set(XKB_KEY_Page_Down, Key::PageDown);
+    set(XKB_KEY_End, Key::End);
+    set(XKB_KEY_Insert, Key::Insert);
+    set(XKB_KEY_Menu, Key::Menu);
+    setRange(table, XKB_KEY_F1, XKB_KEY_F24, Key::F1);
+    set(XKB_KEY_Shift_L, Key::LShift);
+    set(XKB_KEY_Shift_R, Key::RShift);
+    set(XKB_KEY_Control_L, Key::LCtrl);
+    set(XKB_KEY_Control_R, Key::RCtrl);
+    set(XKB_KEY_Caps_Lock, Key::CapsLock);
+    set(XKB_KEY_Alt_L, Key::LAlt);
+    set(XKB_KEY_Alt_R, Key::RAlt);
+    set(XKB_KEY_Super_L, Key::Super);
+    set(XKB_KEY_Super_R, Key::Super);
+
+    // Keypad, without NumLock the digits produce the keysyms of the navigation keys printed on them
+    set(XKB_KEY_Num_Lock, Key::NumLock);
+    setRange(table, XKB_KEY_KP_0, XKB_KEY_KP_9, Key::KP0);
+    set(XKB_KEY_KP_Insert, Key::KP0);
+    set(XKB_KEY_KP_End, Key::KP1);
+    set(XKB_KEY_KP_Down, Key::KP2);
+    set(XKB_KEY_KP_Page_Down, Key::KP3);
+    set(XKB_KEY_KP_Left, Key::KP4);
+    set(XKB_KEY_KP_Begin, Key::KP5);
+    set(XKB_KEY_KP_Right, Key::KP6);
+    set(XKB_KEY_KP_Home, Key::KP7);
+    set(XKB_KEY_KP_Up, Key::KP8);
+    set(XKB_KEY_KP_Page_Up, Key::KP9);
+    set(XKB_KEY_KP_Decimal, Key::KPDecimal);
+    set(XKB_KEY_KP_Separator, Key::KPDecimal);
+    set(XKB_KEY_KP_Delete, Key::KPDecimal);
+    set(XKB_KEY_KP_Divide, Key::KPDivide);
+    set(XKB_KEY_KP_Multiply, Key::KPMultiply);
+    set(XKB_KEY_KP_Subtract, Key::KPSubtract);
+    set(XKB_KEY_KP_Add, Key::KPAdd);
+    set(XKB_KEY_KP_Enter, Key::KPEnter);
+    set(XKB_KEY_KP_Equal, Key::KPEquals);
+
+    // XFree86 vendor keysyms
+    set(XKB_KEY_XF86AudioPlay, Key::MediaPlay);
+    set(XKB_KEY_XF86AudioPause, Key::MediaPause);
+    set(XKB_KEY_XF86AudioStop, Key::MediaStop);
+    set(XKB_KEY_XF86AudioNext, Key::MediaNext);
+    set(XKB_KEY_XF86AudioPrev, Key::MediaPrevious);
+    set(XKB_KEY_XF86AudioMute, Key::VolumeMute);
+    set(XKB_KEY_XF86AudioLowerVolume, Key::VolumeDown);
+    set(XKB_KEY_XF86AudioRaiseVolume, Key::VolumeUp);
+
+    return table;
+}
+
+static constexpr KeysymTable KEYSYM_TABLE = createKeysymTable();
+
+static_assert(KEYSYM_TABLE[getIndex(XKB_KEY_q)] == (u8)Key::Q);
+static_assert(KEYSYM_TABLE[getIndex(XKB_KEY_F24)] == (u8)Key::F24);
+static_assert(KEYSYM_TABLE[getIndex(XKB_KEY_KP_9)] == (u8)Key::KP9);
+static_assert(KEYSYM_TABLE[getIndex(XKB_KEY_XF86AudioRaiseVolume)] == (u8)Key::VolumeUp);
+static_assert(KEYSYM_TABLE[getIndex(0x10000 | XKB_KEY_Escape)] == (u8)Key::Unknown);
+
+Key xkbKeysymToKey(u32 keysym) { return (Key)KEYSYM_TABLE[getIndex(keysym)]; }
+
+/****************
+ * XkbTextInput *
+ ****************/
+
+// Compose tables are per locale, picked with the same precedence setlocale uses
+static const char* getLocale() {
+    for (const char* name : {"LC_ALL", "LC_CTYPE", "LANG"}) {
+        const char* locale = std::getenv(name);
+        if (locale and *locale) return locale;
+    }
+    return "C";
+}
+
+// Keys like Enter, Backspace or Ctrl with a letter produce control characters, which aren't text
+static bool isPrintable(const char* text) {
+    if (!*text) return false;
+    for (const char* c = text; *c; c++)
+        if ((u8)*c < 0x20 or *c == 0x7f) return false;
+    return true;
 }
 
-Key xkbKeysymToKey(u32 keysym) {
-    if (!keymapInit) initKeyMap();
+XkbTextInput::XkbTextInput(xkb_context* context) {
+    composeTable = xkb_compose_table_new_from_locale(context, getLocale(), XKB_COMPOSE_COMPILE_NO_FLAGS);
+    if (composeTable) composeState = xkb_compose_state_new(composeTable, XKB_COMPOSE_STATE_NO_FLAGS);
+}
+
+XkbTextInput::~XkbTextInput() {
+    xkb_compose_state_unref(composeState);
+    xkb_compose_table_unref(composeTable);
+}
+
+const char* XkbTextInput::keyPressed(xkb_state* state, xkb_keycode_t keycode, bool repeat) {
+    if (composeState and !repeat) {
+        // Modifier keysyms are ignored by the compose state and leave a sequence in progress untouched
+        xkb_compose_state_feed(composeState, xkb_state_key_get_one_sym(state, keycode));
+        switch (xkb_compose_state_get_status(composeState)) {
+            case XKB_COMPOSE_COMPOSING: return nullptr;
+            case XKB_COMPOSE_CANCELLED: xkb_compose_state_reset(composeState); return nullptr;
+            case XKB_COMPOSE_COMPOSED:
+                xkb_compose_state_get_utf8(composeState, buffer, sizeof(buffer));
+                xkb_compose_state_reset(composeState);
+                return isPrintable(buffer) ? buffer : nullptr;
+            case XKB_COMPOSE_NOTHING: break;
+        }
+    }
 
-    if (keysym >= 0xff00 and keysym < 0x10000) keysym -= 0xfe00;  // control keys
-    if (keysym >= KEY_MAP_MAX) return Key::Unknown;
-    return KEYMAP[keysym];
-}
\ No newline at end of file
+    xkb_state_key_get_utf8(state, keycode, buffer, sizeof(buffer));
+    return isPrintable(buffer) ? buffer : nullptr;
+}
+
+void XkbTextInput::reset() {
+    if (composeState) xkb_compose_state_reset(composeState);
+}
@@ -1,5 +1,42 @@
 #pragma once
 
+#include <xkbcommon/xkbcommon-compose.h>
+#include <xkbcommon/xkbcommon.h>
+
 #include "../Input/Event.hpp"
 
-Key xkbKeysymToKey(u32 keysym);
\ No newline at end of file
+/// Shared by the X11 and Wayland backends, a single lookup into a table built at compile time
+Key xkbKeysymToKey(u32 keysym);
+
+/**
+ * @brief Turns key presses into text, with the compose table of the user's locale for dead keys and compose
+ * sequences.
+ *
+ * Shared by the X11 and Wayland backends. Without a compose table for the locale keys still produce the text
+ * of the keymap.
+ */
+class XkbTextInput {
+   private:
+    xkb_compose_table* composeTable{};
+    xkb_compose_state* composeState{};
+    char buffer[64];
+
+   public:
+    explicit XkbTextInput(xkb_context* context);
+    ~XkbTextInput();
+
+    XkbTextInput(const XkbTextInput&)            = delete;
+    XkbTextInput& operator=(const XkbTextInput&) = delete;
+
+    /**
+     * @brief Returns the text a key press finishes, valid until the next call.
+     *
+     * @param state Keyboard state with the current modifiers applied.
+     * @param repeat Repeats produce the text of the key itself and don't take part in compose sequences.
+     * @return nullptr while a compose sequence is in progress or if the key produces no printable text.
+     */
+    const char* keyPressed(xkb_state* state, xkb_keycode_t keycode, bool repeat);
+
+    /// Abandons a compose sequence in progress, when the keyboard focus moves to another window
+    void reset();
+};
@@ -1,44 +1,37 @@
 #include "Window.hpp"
 
-void Window::exitF() {
-    if (_exitF) _exitF();
-}
-void Window::resizeF(const ResizeEvent& e) {
-    if (_resizeF) _resizeF(e);
-}
-void Window::mouseMoveF(const MouseMoveEvent& e) {
-    mouse.setPos(e.x, e.y);
-    if (_mouseMoveF) _mouseMoveF(e);
-}
-void Window::mouseButtonPressedF(const MouseButtonPressedEvent& e) {
-    mouse.setButton(e.button, true);
-    if (_mouseButtonPressedF) _mouseButtonPressedF(e);
-}
-void Window::mouseButtonReleasedF(const MouseButtonReleasedEvent& e) {
-    mouse.setButton(e.button, false);
-    if (_mouseButtonReleasedF) _mouseButtonReleasedF(e);
-}
-void Window::keyPressedF(const KeyPressedEvent& e) {
-    keyboard.setKey(e.key, true);
-    keyboard.setModifiers(e.modifiers);
-    if (_keyPressedF) _keyPressedF(e);
-}
-void Window::keyReleasedF(const KeyReleasedEvent& e) {
-    keyboard.setKey(e.key, false);
-    keyboard.setModifiers(e.modifiers);
-    if (_keyReleasedF) _keyReleasedF(e);
+#include "../Input/InputRecording.hpp"
+
+void Window::pollEvents(Vec<Event>& _events) {
+    events.poll(_events, motionHistory);
+    if (recorder) recorder->record(_events);
+
+    for (const Event& e : _events) {
+        switch (e.kind) {
+            case EventKind::MouseMove: mouse.setPos(e.mouseMove.x, e.mouseMove.y); break;
+            case EventKind::MouseButtonPressed: mouse.setButton(e.mouseButtonPressed.button, true); break;
+            case EventKind::MouseButtonReleased: mouse.setButton(e.mouseButtonReleased.button, false); break;
+            case EventKind::KeyPressed:
+                keyboard.setKey(e.keyPressed.key, true);
+                keyboard.setModifiers(e.keyPressed.modifiers);
+                break;
+            case EventKind::KeyReleased:
+                keyboard.setKey(e.keyReleased.key, false);
+                keyboard.setModifiers(e.keyReleased.modifiers);
+                break;
+            default: break;
+        }
+    }
 }
 
-void Window::setExitCallback(const std::function<void()>& f) { _exitF = f; }
-void Window::setResizeCallback(const std::function<void(const ResizeEvent&)>& f) { _resizeF = f; }
-void Window::setMouseMoveCallback(const std::function<void(const MouseMoveEvent&)>& f) { _mouseMoveF = f; }
-void Window::setMouseButtonPressedCallback(const std::function<void(const MouseButtonPressedEvent&)>& f) {
-    _mouseButtonPressedF = f;
+void Window::pushPresentFeedback(const PresentFeedback& feedback) {
+    std::lock_guard lock(feedbackMutex);
+    presentFeedback.push(feedback);
 }
-void Window::setMouseButtonReleasedCallback(const std::function<void(const MouseButtonReleasedEvent&)>& f) {
-    _mouseButtonReleasedF = f;
+
+void Window::pollPresentFeedback(Vec<PresentFeedback>& feedback) {
+    feedback.clear();
+
+    std::lock_guard lock(feedbackMutex);
+    std::swap(presentFeedback, feedback);
 }
-void Window::setKeyPressedCallback(const std::function<void(const KeyPressedEvent&)>& f) { _keyPressedF = f; }
-void Window::setKeyReleasedCallback(const std::function<void(const KeyReleasedEvent&)>& f) {
-    _keyReleasedF = f;
-}
\ No newline at end of file
@@ -1,45 +1,88 @@
 #pragma once
 
+#include <mutex>
+
 #include "../Input/Event.hpp"
+#include "../Input/EventQueue.hpp"
 #include "Core/Core.hpp"
 
+class InputRecorder;
+
+/// What the compositor reports about when and how a frame reached the screen
+struct PresentFeedback {
+    u64 frameIndex;
+    bool discarded;       ///< Replaced before it was shown, the other fields are 0
+    u64 presentTime;      ///< ns, CLOCK_MONOTONIC, 0 if the compositor uses another clock
+    u32 refreshInterval;  ///< ns until the next refresh after presentTime, 0 for variable refresh rates
+    u64 sequence;         ///< Refresh counter of the output when the frame was shown, 0 if unknown
+    bool vsync;           ///< Presented synchronized to the refresh, i.e. without tearing
+    bool zeroCopy;        ///< Scanned out from the client buffer without a copy by the compositor
+    bool hardwareClock;   ///< presentTime comes from the display hardware instead of a software estimate
+};
+
 class Window {
    private:
     Mouse mouse;
     Keyboard keyboard;
 
-    std::function<void()> _exitF                                               = nullptr;
-    std::function<void(const ResizeEvent&)> _resizeF                           = nullptr;
-    std::function<void(const MouseMoveEvent&)> _mouseMoveF                     = nullptr;
-    std::function<void(const MouseButtonPressedEvent&)> _mouseButtonPressedF   = nullptr;
-    std::function<void(const MouseButtonReleasedEvent&)> _mouseButtonReleasedF = nullptr;
-    std::function<void(const KeyPressedEvent&)> _keyPressedF                   = nullptr;
-    std::function<void(const KeyReleasedEvent&)> _keyReleasedF                 = nullptr;
+    EventQueue events;
+    Vec<MotionSample> motionHistory;
+    InputRecorder* recorder = nullptr;
+
+    std::mutex feedbackMutex;
+    Vec<PresentFeedback> presentFeedback;
 
    protected:
     Window() = default;
-    void exitF();
-    void resizeF(const ResizeEvent& e);
-    void mouseMoveF(const MouseMoveEvent& e);
-    void mouseButtonPressedF(const MouseButtonPressedEvent& e);
-    void mouseButtonReleasedF(const MouseButtonReleasedEvent& e);
-    void keyPressedF(const KeyPressedEvent& e);
-    void keyReleasedF(const KeyReleasedEvent& e);
+
+    /// Called by the backends while the window connection dispatches
+    inline void pushEvent(const Event& event) { events.push(event); }
+    /// Called for every pointer position the backend receives, before motion events are coalesced
+    inline void pushMotionSample(const MotionSample& sample) { events.pushMotionSample(sample); }
+    /// Called by the backends when feedback requested with requestPresentFeedback arrives
+    void pushPresentFeedback(const PresentFeedback& feedback);
 
    public:
     virtual ~Window() = default;
 
-    void setExitCallback(const std::function<void()>& f);
-    void setResizeCallback(const std::function<void(const ResizeEvent&)>& f);
-    void setMouseMoveCallback(const std::function<void(const MouseMoveEvent&)>& f);
-    void setMouseButtonPressedCallback(const std::function<void(const MouseButtonPressedEvent&)>& f);
-    void setMouseButtonReleasedCallback(const std::function<void(const MouseButtonReleasedEvent&)>& f);
-    void setKeyPressedCallback(const std::function<void(const KeyPressedEvent&)>& f);
-    void setKeyReleasedCallback(const std::function<void(const KeyReleasedEvent&)>& f);
+    /**
+     * @brief Moves the events received since the last call into events and updates the mouse and keyboard
+     * state from them.
+     *
+     * Meant to be called once per frame, so handlers run at a known point instead of in the middle of
+     * protocol dispatch.
+     */
+    void pollEvents(Vec<Event>& events);
+
+    /// Whether pollEvents would return any events, can be called from any thread
+    [[nodiscard]] inline bool hasPendingEvents() { return events.hasEvents(); }
 
+    /// Records the events returned by every pollEvents call until reset to nullptr, the recorder is not owned
+    inline void setRecorder(InputRecorder* _recorder) { recorder = _recorder; }
+
+    /// Keeps every pointer position between frames, see EventQueue
+    inline void setMotionHistoryEnabled(bool enabled) { events.setMotionHistory(enabled); }
+
+    /// Pointer positions received before the last pollEvents call, oldest first, empty unless enabled
+    [[nodiscard]] inline const Vec<MotionSample>& getMotionHistory() const { return motionHistory; }
+
+    /// State as of the last pollEvents call
     [[nodiscard]] const Mouse& getMouse() const { return mouse; }
     [[nodiscard]] const Keyboard& getKeyboard() const { return keyboard; }
 
+    /**
+     * @brief Asks the compositor to report when the next content update of the window is shown.
+     *
+     * Has to be called before the present of the frame, since the feedback belongs to the next commit of the
+     * surface. Can be called from any thread.
+     *
+     * @return False if the backend doesn't support presentation feedback.
+     */
+    virtual bool requestPresentFeedback(u64 frameIndex) { return false; }
+
+    /// Moves the feedback received since the last call into feedback, in present order
+    void pollPresentFeedback(Vec<PresentFeedback>& feedback);
+
     virtual void show() = 0;
     virtual void hide() = 0;
 
@@ -51,4 +94,4 @@ class Window {
 
     virtual u32 getWidth()  = 0;
     virtual u32 getHeight() = 0;
-};
\ No newline at end of file
+};
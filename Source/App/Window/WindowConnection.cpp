@@ -7,10 +7,10 @@
 const bool useWayland = std::getenv("XDG_SESSION_TYPE") == std::string("wayland");
 #endif
 
-WindowConnection* WindowConnection::create() {
+WindowConnection* WindowConnection::create(bool inputThread, const std::function<void()>& readCallback) {
 #ifdef __linux__
     if (useWayland)
-        return new WlConnection;
+        return new WlConnection(inputThread, readCallback);
     else
         return new X11Connection;
 #endif
@@ -1,15 +1,36 @@
 #pragma once
 
+#include <functional>
+
 #include "Window.hpp"
 
+class EventLoop;
+
 class WindowConnection {
    protected:
+    /// Called on the input thread after it read events, see create
+    std::function<void()> readCallback;
+
     WindowConnection() = default;
 
    public:
-    static WindowConnection* create();
+    /**
+     * @brief Connects to the display server of the session.
+     *
+     * @param inputThread Read input on a dedicated thread where the backend supports it, see WlConnection.
+     * @param readCallback Runs on the input thread after it read events. The fd doesn't become readable for
+     * those, so a thread waiting on it has to be woken through this instead.
+     */
+    static WindowConnection* create(bool inputThread = false, const std::function<void()>& readCallback = {});
 
     virtual ~WindowConnection()    = default;
     virtual Window* createWindow() = 0;
-    virtual void update()          = 0;
+    /// Reads and dispatches everything that arrived and sends the pending requests, never blocks
+    virtual void update() = 0;
+
+    /**
+     * @brief Registers every fd the connection has to react to, like the socket to the server, so a thread
+     * waiting in the loop wakes for them. Has to be called from the thread calling update.
+     */
+    virtual void addToEventLoop(EventLoop* loop) = 0;
 };
\ No newline at end of file
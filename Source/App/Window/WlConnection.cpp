@@ -1,34 +1,129 @@
 #include "WlConnection.hpp"
 
+#include <algorithm>
+#include <cerrno>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
 
+#include "Core/EventLoop.hpp"
 #include "LinuxCommon.hpp"
 #include "WlWindow.hpp"
 
-WlConnection::WlConnection() {
-    context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+// Repeats that piled up while the thread dispatching the keyboard was stalled are dropped past this
+const u64 MAX_REPEAT_CATCH_UP = 4;
+
+WlConnection::WlConnection(bool useInputThread, const std::function<void()> &_readCallback) {
+    context   = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+    textInput = new XkbTextInput(context);
+    repeatFd  = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
 
     display = wl_display_connect(nullptr);
     if (!display) throw std::runtime_error("Failed to connect to wayland compositor");
+    // Has to exist before the seat is bound, so no seat event can end up on the default queue
+    if (useInputThread) inputQueue = wl_display_create_queue(display);
+
     registry = wl_display_get_registry(display);
     wl_registry_add_listener(registry, &registryListener, this);
     wl_display_roundtrip(display);
+
+    if (useInputThread) {
+        readCallback = _readCallback;
+        wakeFd       = eventfd(0, EFD_CLOEXEC);
+        inputThread  = std::thread(&WlConnection::runInputThread, this);
+    }
 }
 
 WlConnection::~WlConnection() {
+    if (inputThread.joinable()) {
+        stopInput = true;
+        u64 one   = 1;
+        while (write(wakeFd, &one, sizeof(one)) == -1 and errno == EINTR) {}
+        inputThread.join();
+        close(wakeFd);
+    }
+
+    if (relativePointer) zwp_relative_pointer_v1_destroy(relativePointer);
+    if (relativePointerManager) zwp_relative_pointer_manager_v1_destroy(relativePointerManager);
+    if (presentation) wp_presentation_destroy(presentation);
+    if (pointer) wl_pointer_release(pointer);
+    if (keyboard) wl_keyboard_release(keyboard);
+    if (seat) wl_seat_release(seat);
+    if (inputQueue) wl_event_queue_destroy(inputQueue);
     wl_registry_destroy(registry);
     wl_display_disconnect(display);
 
+    close(repeatFd);
+    delete textInput;
     xkb_state_unref(state);
     xkb_state_unref(textState);
     xkb_keymap_unref(keymap);
     xkb_context_unref(context);
 }
 
-void WlConnection::update() { wl_display_dispatch_pending(display); }
+void WlConnection::update() {
+    // Keep reading while the compositor sends, one read only takes what fits into the connection buffer
+    while (readAndDispatch(nullptr, 0)) {}
+    if (wl_display_get_error(display)) throw std::runtime_error("Lost connection to wayland compositor");
+}
+
+void WlConnection::addToEventLoop(EventLoop *loop) {
+    loop->addFd(wl_display_get_fd(display), EPOLLIN, [this](u32) { update(); });
+    // With an input thread it dispatches the keyboard and repeats the keys itself
+    if (!inputThread.joinable()) loop->addFd(repeatFd, EPOLLIN, [this](u32) { dispatchKeyRepeat(); });
+}
 
 Window *WlConnection::createWindow() { return new WlWindow(this); }
 
+bool WlConnection::readAndDispatch(wl_event_queue *queue, i32 timeout) {
+    auto dispatch = [&]() {
+        std::lock_guard lock(inputMutex);
+        if (queue)
+            wl_display_dispatch_queue_pending(display, queue);
+        else
+            wl_display_dispatch_pending(display);
+    };
+
+    // Reading is only allowed with an empty queue, otherwise queued events could be overtaken
+    while ((queue ? wl_display_prepare_read_queue(display, queue) : wl_display_prepare_read(display)) != 0) {
+        dispatch();
+    }
+    wl_display_flush(display);
+
+    // Key repeat belongs to whoever dispatches the keyboard, poll skips negative fds
+    pollfd fds[3] = {
+        {.fd = wl_display_get_fd(display), .events = POLLIN},
+        {.fd = queue == inputQueue ? repeatFd : -1, .events = POLLIN},
+        {.fd = wakeFd, .events = POLLIN},
+    };
+    bool readable = poll(fds, 3, timeout) > 0 and (fds[0].revents & POLLIN);
+    if (!readable) {
+        wl_display_cancel_read(display);
+    } else {
+        // Blocks until the other thread that prepared to read, if any, reads too, then both get their events
+        if (wl_display_read_events(display) == -1) return false;
+        dispatch();
+    }
+    // After the events read with it, a release among them already stopped the repeat
+    if (fds[1].revents & POLLIN) dispatchKeyRepeat();
+    return readable;
+}
+
+void WlConnection::runInputThread() {
+    // On a connection error update throws on the thread owning the connection
+    while (!stopInput and !wl_display_get_error(display)) {
+        // Events for the default queue are read here too, which leaves nothing for a waiter on the fd to see
+        if (readAndDispatch(inputQueue, -1) and readCallback) readCallback();
+    }
+}
+
+WlWindow *WlConnection::getWindow(wl_surface *surface) {
+    return surface ? (WlWindow *)wl_surface_get_user_data(surface) : nullptr;
+}
+
 /******************
  * Base callbacks *
  ******************/
@@ -44,6 +139,8 @@ void WlConnection::registryHandleGlobal(void *data, wl_registry *registry, u32 n
     // wl_seat
     else if (std::strcmp(interface, wl_seat_interface.name) == 0) {
         self->seat = (wl_seat *)wl_registry_bind(registry, name, &wl_seat_interface, 8);
+        // Devices created from the seat inherit its queue. Nothing was sent yet, so no event can be missed
+        if (self->inputQueue) wl_proxy_set_queue((wl_proxy *)self->seat, self->inputQueue);
         wl_seat_add_listener(self->seat, &self->seatListener, self);
     }
     // xdg_wm_base
@@ -56,10 +153,27 @@ void WlConnection::registryHandleGlobal(void *data, wl_registry *registry, u32 n
         self->decorationManager = (zxdg_decoration_manager_v1 *)wl_registry_bind(
             registry, name, &zxdg_decoration_manager_v1_interface, version);
     }
+    // zwp_relative_pointer_manager_v1
+    else if (std::strcmp(interface, zwp_relative_pointer_manager_v1_interface.name) == 0) {
+        self->relativePointerManager = (zwp_relative_pointer_manager_v1 *)wl_registry_bind(
+            registry, name, &zwp_relative_pointer_manager_v1_interface, 1);
+    }
+    // wp_presentation
+    else if (std::strcmp(interface, wp_presentation_interface.name) == 0) {
+        self->presentation =
+            (wp_presentation *)wl_registry_bind(registry, name, &wp_presentation_interface, 1);
+        wp_presentation_add_listener(self->presentation, &self->presentationListener, self);
+    }
 }
 
 void WlConnection::registryHandleGlobalRemove(void *, wl_registry *, u32) {}
 
+void WlConnection::presentationHandleClockId(void *data, wp_presentation *, u32 clockId) {
+    auto self = (WlConnection *)data;
+
+    self->presentationClock = clockId;
+}
+
 void WlConnection::wmBaseHandlePing(void *, xdg_wm_base *wmBase, u32 serial) {
     xdg_wm_base_pong(wmBase, serial);
 }
@@ -71,7 +185,21 @@ void WlConnection::seatHandleCapabilities(void *data, wl_seat *seat, u32 capabil
     if (hasPointer and !self->pointer) {
         self->pointer = wl_seat_get_pointer(seat);
         wl_pointer_add_listener(self->pointer, &self->pointerListener, self);
+
+        // Capabilities are only sent once the seat is bound, after all globals, so the manager is known
+        if (self->relativePointerManager) {
+            // Created through a wrapper on the queue of the seat, so the first events already go there
+            auto manager =
+                (zwp_relative_pointer_manager_v1 *)wl_proxy_create_wrapper(self->relativePointerManager);
+            wl_proxy_set_queue((wl_proxy *)manager, self->inputQueue);
+            self->relativePointer =
+                zwp_relative_pointer_manager_v1_get_relative_pointer(manager, self->pointer);
+            wl_proxy_wrapper_destroy(manager);
+            zwp_relative_pointer_v1_add_listener(self->relativePointer, &self->relativePointerListener, self);
+        }
     } else if (!hasPointer and self->pointer) {
+        if (self->relativePointer) zwp_relative_pointer_v1_destroy(self->relativePointer);
+        self->relativePointer = nullptr;
         wl_pointer_release(self->pointer);
         self->pointer = nullptr;
     }
@@ -96,7 +224,7 @@ void WlConnection::pointerHandleEnter(void *data, wl_pointer *, u32 serial, wl_s
                                       wl_fixed_t y) {
     auto self = (WlConnection *)data;
 
-    self->pointerCurrentSurface = surface;
+    self->pointerWindow = getWindow(surface);
 
     self->pointerEvent.mask   |= PointerEventMaskEnter;
     self->pointerEvent.serial  = serial;
@@ -107,6 +235,8 @@ void WlConnection::pointerHandleEnter(void *data, wl_pointer *, u32 serial, wl_s
 void WlConnection::pointerHandleLeave(void *data, wl_pointer *, u32 serial, wl_surface *) {
     auto self = (WlConnection *)data;
 
+    self->pointerWindow = nullptr;
+
     self->pointerEvent.mask   |= PointerEventMaskLeave;
     self->pointerEvent.serial  = serial;
 }
@@ -177,14 +307,19 @@ void WlConnection::pointerHandleAxisRelativeDirection(void *data, wl_pointer *,
 void WlConnection::pointerHandleFrame(void *data, wl_pointer *) {
     auto self             = (WlConnection *)data;
     WlPointerEvent &event = self->pointerEvent;
-    WlWindow *window;
-    for (WlWindow *w : self->windows) {
-        if (w->surface == self->pointerCurrentSurface) window = w;
+    WlWindow *window      = self->pointerWindow;
+    if (!window) {
+        event = {};
+        return;
     }
 
     if (event.mask & PointerEventMaskMotion) {
+        // Every frame is kept for the motion history, the event itself is coalesced until the next poll
+        window->pushMotionSample({(f32)wl_fixed_to_double(event.x), (f32)wl_fixed_to_double(event.y),
+                                  (u64)event.time * 1000});
+
         i32 x = wl_fixed_to_int(event.x), y = wl_fixed_to_int(event.y);
-        window->mouseMoveF({x, y, x - self->lastMouseX, y - self->lastMouseY});
+        window->pushEvent(MouseMoveEvent(x, y, x - self->lastMouseX, y - self->lastMouseY));
         self->lastMouseX = x, self->lastMouseY = y;
     } else if (event.mask & PointerEventMaskButton) {
         MouseButton button;
@@ -196,9 +331,9 @@ void WlConnection::pointerHandleFrame(void *data, wl_pointer *) {
             case 0x114: button = MouseButton::_5; break;
         }
         if (event.state)
-            window->mouseButtonPressedF(MouseButtonPressedEvent(button));
+            window->pushEvent(MouseButtonPressedEvent(button));
         else
-            window->mouseButtonReleasedF(MouseButtonReleasedEvent(button));
+            window->pushEvent(MouseButtonReleasedEvent(button));
     }
 
     // TODO: Axis events and enter/leave
@@ -206,6 +341,17 @@ void WlConnection::pointerHandleFrame(void *data, wl_pointer *) {
     event = {};
 }
 
+void WlConnection::relativePointerHandleRelativeMotion(void *data, zwp_relative_pointer_v1 *, u32, u32,
+                                                       wl_fixed_t dx, wl_fixed_t dy, wl_fixed_t dxUnaccel,
+                                                       wl_fixed_t dyUnaccel) {
+    auto self = (WlConnection *)data;
+    if (!self->pointerWindow) return;
+    self->pointerWindow->pushEvent(MouseRelativeMoveEvent((f32)wl_fixed_to_double(dx),
+                                                          (f32)wl_fixed_to_double(dy),
+                                                          (f32)wl_fixed_to_double(dxUnaccel),
+                                                          (f32)wl_fixed_to_double(dyUnaccel)));
+}
+
 /**********************
  * Keyboard callbacks *
  **********************/
@@ -218,6 +364,8 @@ void WlConnection::keyboardHandleKeymap(void *data, wl_keyboard *, u32 format, i
 
     void *ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
 
+    // Keycodes of the old keymap mean nothing in the new one
+    self->stopKeyRepeat();
     xkb_state_unref(self->state);
     xkb_state_unref(self->textState);
     xkb_keymap_unref(self->keymap);
@@ -239,30 +387,31 @@ void WlConnection::keyboardHandleKeymap(void *data, wl_keyboard *, u32 format, i
 void WlConnection::keyboardHandleEnter(void *data, wl_keyboard *, u32, wl_surface *surface, wl_array *) {
     auto self = (WlConnection *)data;
 
-    self->keyboardCurrentSurface = surface;
+    self->keyboardWindow = getWindow(surface);
 }
 
-void WlConnection::keyboardHandleLeave(void *, wl_keyboard *, u32, wl_surface *) {}
-
-void WlConnection::keyboardHandleKey(void *data, wl_keyboard *, u32, u32, u32 key, u32 state) {
+void WlConnection::keyboardHandleLeave(void *data, wl_keyboard *, u32, wl_surface *) {
     auto self = (WlConnection *)data;
-    WlWindow *window;
-    for (WlWindow *w : self->windows) {
-        if (w->surface == self->keyboardCurrentSurface) window = w;
-    }
 
-    u32 keycode      = key + 8;
-    xkb_keysym_t sym = xkb_state_key_get_one_sym(self->state, keycode);
-    Key _key         = xkbKeysymToKey(sym);
-
-    // TODO: text input event
-    //    char buf[64];
-    //    bool isText = xkb_state_key_get_utf8(self->textState, keycode, buf, 64);
+    self->keyboardWindow = nullptr;
+    self->stopKeyRepeat();
+    self->textInput->reset();
+}
 
-    if (state)
-        window->keyPressedF(KeyPressedEvent(_key, self->modifiers));
-    else
-        window->keyReleasedF(KeyReleasedEvent(_key, self->modifiers));
+void WlConnection::keyboardHandleKey(void *data, wl_keyboard *, u32, u32, u32 key, u32 state) {
+    auto self        = (WlConnection *)data;
+    WlWindow *window = self->keyboardWindow;
+    if (!window) return;
+
+    u32 keycode = key + 8;
+    if (state == WL_KEYBOARD_KEY_STATE_PRESSED) {
+        self->pushKeyPress(window, keycode, false);
+        if (xkb_keymap_key_repeats(self->keymap, keycode)) self->startKeyRepeat(keycode);
+    } else {
+        if (keycode == self->repeatKey) self->stopKeyRepeat();
+        Key _key = xkbKeysymToKey(xkb_state_key_get_one_sym(self->state, keycode));
+        window->pushEvent(KeyReleasedEvent(_key, self->modifiers));
+    }
 }
 
 void WlConnection::keyboardHandleModifiers(void *data, wl_keyboard *, u32, u32 modsDepressed, u32 modsLatched,
@@ -283,4 +432,51 @@ void WlConnection::keyboardHandleModifiers(void *data, wl_keyboard *, u32, u32 m
         xkb_state_mod_index_is_active(self->textState, self->numLockIdx, XKB_STATE_MODS_EFFECTIVE));
 }
 
-void WlConnection::keyboardHandleRepeatInfo(void *, wl_keyboard *, i32, i32) {}
\ No newline at end of file
+void WlConnection::keyboardHandleRepeatInfo(void *data, wl_keyboard *, i32 rate, i32 delay) {
+    auto self = (WlConnection *)data;
+
+    self->repeatRate  = rate;
+    self->repeatDelay = delay;
+    if (rate <= 0) self->stopKeyRepeat();
+}
+
+void WlConnection::pushKeyPress(WlWindow *window, u32 keycode, bool repeat) {
+    // The key comes from the state without modifiers, so Shift+1 still is Num1, the text from textState
+    Key key = xkbKeysymToKey(xkb_state_key_get_one_sym(state, keycode));
+    window->pushEvent(KeyPressedEvent(key, modifiers, repeat));
+    if (const char *text = textInput->keyPressed(textState, keycode, repeat))
+        window->pushEvent(TextInputEvent(text));
+}
+
+void WlConnection::startKeyRepeat(u32 keycode) {
+    if (repeatRate <= 0) return;
+    repeatKey = keycode;
+
+    i64 interval = 1000000000 / repeatRate;
+    i64 delay    = repeatDelay > 0 ? (i64)repeatDelay * 1000000 : 1;  // A zero value would disarm the timer
+    itimerspec spec{
+        .it_interval = {.tv_sec = interval / 1000000000, .tv_nsec = interval % 1000000000},
+        .it_value    = {.tv_sec = delay / 1000000000, .tv_nsec = delay % 1000000000},
+    };
+    timerfd_settime(repeatFd, 0, &spec, nullptr);
+}
+
+void WlConnection::stopKeyRepeat() {
+    if (!repeatKey) return;
+    repeatKey = 0;
+
+    // Disarming also clears expirations that weren't read yet
+    itimerspec spec{};
+    timerfd_settime(repeatFd, 0, &spec, nullptr);
+}
+
+void WlConnection::dispatchKeyRepeat() {
+    u64 expirations;
+    if (read(repeatFd, &expirations, sizeof(expirations)) != sizeof(expirations)) return;  // Disarmed since
+
+    std::lock_guard lock(inputMutex);
+    WlWindow *window = keyboardWindow;
+    if (!window or !repeatKey) return;
+    expirations = std::min(expirations, MAX_REPEAT_CATCH_UP);
+    for (u64 i = 0; i < expirations; i++) pushKeyPress(window, repeatKey, true);
+}
\ No newline at end of file
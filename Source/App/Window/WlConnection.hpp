@@ -3,14 +3,36 @@
 #include <wayland-client.h>
 #include <xkbcommon/xkbcommon.h>
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+
 #include "../Input/Event.hpp"
 #include "Core/Core.hpp"
+#include "ThirdParty/wayland/presentation-time.h"
+#include "ThirdParty/wayland/relative-pointer.h"
 #include "ThirdParty/wayland/xdg-decoration.h"
 #include "ThirdParty/wayland/xdg-shell.h"
 #include "WindowConnection.hpp"
 
 class WlWindow;
-
+class XkbTextInput;
+
+/**
+ * @brief Connection to the wayland compositor.
+ *
+ * update reads whatever the compositor sent without blocking, using the prepare_read / read_events protocol
+ * so it can share the socket with other readers, and dispatches it.
+ *
+ * With an input thread, the seat and the input devices live on a private event queue that a dedicated thread
+ * reads and dispatches as soon as data arrives, so input is timestamped and queued on the windows even
+ * while the thread calling update is busy. Everything else, like configure events, stays on the default
+ * queue and is dispatched by update.
+ *
+ * Wayland leaves key repeat to the client. A timerfd armed with the rate and delay of the compositor is
+ * polled together with the socket by whoever dispatches the keyboard, so a held key costs one wakeup per
+ * repeat and nothing in between.
+ */
 class WlConnection : public WindowConnection {
     // WlConnection and WlWindow are tightly coupled
     // This may be bad practice, but keeping them separate is impossible as they need each other to function
@@ -50,22 +72,39 @@ class WlConnection : public WindowConnection {
     wl_display* display;
     wl_registry* registry;
 
+    wl_event_queue* inputQueue{};  ///< Only with an input thread, nullptr means the default queue
+    std::thread inputThread;
+    i32 wakeFd = -1;  ///< eventfd to stop the input thread while it waits for the socket
+    std::atomic<bool> stopInput = false;
+    /// Held while the input thread dispatches, so windows aren't destroyed while the input handlers use them
+    std::mutex inputMutex;
+
     xkb_context* context;
     xkb_keymap* keymap{};
     xkb_state* state{};
     xkb_state* textState{};
+    XkbTextInput* textInput;
+
+    i32 repeatFd    = -1;   ///< timerfd, armed while a key repeats
+    i32 repeatRate  = 25;   ///< Repeats per second, 0 disables repeat
+    i32 repeatDelay = 600;  ///< Milliseconds from the press to the first repeat
+    u32 repeatKey   = 0;    ///< xkb keycode of the repeating key, 0 if none
 
     wl_compositor* compositor{};
     xdg_wm_base* wmBase{};
     wl_seat* seat{};
     zxdg_decoration_manager_v1* decorationManager{};
+    zwp_relative_pointer_manager_v1* relativePointerManager{};  ///< Optional
+    wp_presentation* presentation{};                            ///< Optional
+    u32 presentationClock = UINT32_MAX;                         ///< clockid_t of the feedback timestamps
 
     wl_keyboard* keyboard{};
     wl_pointer* pointer{};
+    zwp_relative_pointer_v1* relativePointer{};
 
-    Vec<WlWindow*> windows;
-    wl_surface* pointerCurrentSurface{};
-    wl_surface* keyboardCurrentSurface{};
+    // Found through the user data of the entered surface, nullptr if the focus is on no window of ours
+    WlWindow* pointerWindow{};
+    WlWindow* keyboardWindow{};
 
     WlPointerEvent pointerEvent{};
     i32 lastMouseX{}, lastMouseY{};
@@ -78,14 +117,35 @@ class WlConnection : public WindowConnection {
     Modifiers modifiers{0};
 
    public:
-    WlConnection();
+    explicit WlConnection(bool useInputThread = false, const std::function<void()>& readCallback = {});
     ~WlConnection() override;
 
     void update() override;
+    void addToEventLoop(EventLoop* loop) override;
 
     Window* createWindow() override;
 
    private:
+    /**
+     * @brief Dispatches what is queued on queue, then waits up to timeout milliseconds (-1 for no limit) for
+     * data on the socket or the wake fd and reads and dispatches it.
+     *
+     * @param queue nullptr for the default queue.
+     * @return Whether data was read from the socket.
+     */
+    bool readAndDispatch(wl_event_queue* queue, i32 timeout);
+    void runInputThread();
+
+    /// Pushes the key and the text it produces to the window with keyboard focus
+    void pushKeyPress(WlWindow* window, u32 keycode, bool repeat);
+    void startKeyRepeat(u32 keycode);
+    void stopKeyRepeat();
+    /// Reads the repeat timer and pushes one press for every time it expired
+    void dispatchKeyRepeat();
+
+    /// Returns nullptr for surfaces that don't belong to a window of this connection
+    static WlWindow* getWindow(wl_surface* surface);
+
     const wl_registry_listener registryListener{
         .global        = registryHandleGlobal,
         .global_remove = registryHandleGlobalRemove,
@@ -94,6 +154,11 @@ class WlConnection : public WindowConnection {
                                      u32 version);
     static void registryHandleGlobalRemove(void* data, wl_registry* registry, u32 name);
 
+    const wp_presentation_listener presentationListener{
+        .clock_id = presentationHandleClockId,
+    };
+    static void presentationHandleClockId(void* data, wp_presentation* presentation, u32 clockId);
+
     const xdg_wm_base_listener wmBaseListener{
         .ping = wmBaseHandlePing,
     };
@@ -133,6 +198,13 @@ class WlConnection : public WindowConnection {
     static void pointerHandleAxisValue120(void* data, wl_pointer* pointer, u32 axis, i32 value120);
     static void pointerHandleAxisRelativeDirection(void* data, wl_pointer* pointer, u32 axis, u32 direction);
 
+    const zwp_relative_pointer_v1_listener relativePointerListener{
+        .relative_motion = relativePointerHandleRelativeMotion,
+    };
+    static void relativePointerHandleRelativeMotion(void* data, zwp_relative_pointer_v1* relativePointer,
+                                                    u32 utimeHi, u32 utimeLo, wl_fixed_t dx, wl_fixed_t dy,
+                                                    wl_fixed_t dxUnaccel, wl_fixed_t dyUnaccel);
+
     const wl_keyboard_listener keyboardListener{
         .keymap      = keyboardHandleKeymap,
         .enter       = keyboardHandleEnter,
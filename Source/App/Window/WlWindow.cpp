@@ -1,11 +1,13 @@
 #include "WlWindow.hpp"
 
+#include <ctime>
+
 #include "WlConnection.hpp"
 
 WlWindow::WlWindow(WlConnection *_connection) : connection(_connection) {
-    connection->windows.push(this);
     surface    = wl_compositor_create_surface(connection->compositor);
     xdgSurface = xdg_wm_base_get_xdg_surface(connection->wmBase, surface);
+    wl_surface_set_user_data(surface, this);  // Lets input events find the window of the focused surface
     xdg_surface_add_listener(xdgSurface, &xdgSurfaceListener, this);
     toplevel = xdg_surface_get_toplevel(xdgSurface);
     xdg_toplevel_add_listener(toplevel, &toplevelListener, this);
@@ -18,10 +20,16 @@ WlWindow::WlWindow(WlConnection *_connection) : connection(_connection) {
 }
 
 WlWindow::~WlWindow() {
-    for (u64 i = 0; i < connection->windows.getSize(); i++) {
-        if (connection->windows[i] == this) {
-            connection->windows.remove(i);
-        }
+    // Dropped with the surface, the compositor won't answer them anymore
+    for (FeedbackRequest *request : pendingFeedback) {
+        wp_presentation_feedback_destroy(request->feedback);
+        delete request;
+    }
+    {
+        // The input thread may be dispatching an event for this window
+        std::lock_guard lock(connection->inputMutex);
+        if (connection->pointerWindow == this) connection->pointerWindow = nullptr;
+        if (connection->keyboardWindow == this) connection->keyboardWindow = nullptr;
     }
     xdg_toplevel_destroy(toplevel);
     xdg_surface_destroy(xdgSurface);
@@ -52,15 +60,85 @@ void WlWindow::setFullscreen(bool value) {
 void WlWindow::resize(u32 _width, u32 _height) {
     width = (i32)_width, height = (i32)_height;
     xdg_surface_set_window_geometry(xdgSurface, 0, 0, (i32)width, (i32)height);
-    wl_surface_commit(surface);
+    commitState();
 }
 
 void WlWindow::setTitle(const String &title) { xdg_toplevel_set_title(toplevel, title.getData()); }
 
+bool WlWindow::requestPresentFeedback(u64 frameIndex) {
+    if (!connection->presentation) return false;
+
+    auto request = new FeedbackRequest{.window = this, .frameIndex = frameIndex};
+    std::lock_guard lock(pendingMutex);
+    // The listener is added before anything is dispatched, events only come after the next commit anyway
+    request->feedback = wp_presentation_feedback(connection->presentation, surface);
+    wp_presentation_feedback_add_listener(request->feedback, &feedbackListener, request);
+    pendingFeedback.push(request);
+    return true;
+}
+
+void WlWindow::commitState() {
+    std::lock_guard lock(pendingMutex);
+    if (pendingFeedback.getSize() > 0)
+        commitDeferred = true;
+    else
+        wl_surface_commit(surface);
+}
+
+void WlWindow::finishFeedback(FeedbackRequest *request, const PresentFeedback &feedback) {
+    {
+        std::lock_guard lock(pendingMutex);
+        for (u64 i = 0; i < pendingFeedback.getSize(); i++) {
+            if (pendingFeedback[i] == request) {
+                pendingFeedback.remove(i);
+                break;
+            }
+        }
+        // No frame waits for feedback anymore, so the deferred commit can't take any
+        if (commitDeferred and pendingFeedback.getSize() == 0) {
+            commitDeferred = false;
+            wl_surface_commit(surface);
+        }
+    }
+    wp_presentation_feedback_destroy(request->feedback);
+    delete request;
+
+    pushPresentFeedback(feedback);
+}
+
+void WlWindow::feedbackHandleSyncOutput(void *, wp_presentation_feedback *, wl_output *) {}
+
+void WlWindow::feedbackHandlePresented(void *data, wp_presentation_feedback *, u32 tvSecHi, u32 tvSecLo,
+                                       u32 tvNsec, u32 refresh, u32 seqHi, u32 seqLo, u32 flags) {
+    auto request   = (FeedbackRequest *)data;
+    WlWindow *self = request->window;
+
+    // Only the clock of FrameClock can be compared with frame start times
+    u64 seconds    = (u64)tvSecHi << 32 | tvSecLo;
+    bool monotonic = self->connection->presentationClock == CLOCK_MONOTONIC;
+
+    self->finishFeedback(request,
+                         {
+                             .frameIndex      = request->frameIndex,
+                             .discarded       = false,
+                             .presentTime     = monotonic ? seconds * 1'000'000'000 + tvNsec : 0,
+                             .refreshInterval = refresh,
+                             .sequence        = (u64)seqHi << 32 | seqLo,
+                             .vsync           = (flags & WP_PRESENTATION_FEEDBACK_KIND_VSYNC) != 0,
+                             .zeroCopy        = (flags & WP_PRESENTATION_FEEDBACK_KIND_ZERO_COPY) != 0,
+                             .hardwareClock   = (flags & WP_PRESENTATION_FEEDBACK_KIND_HW_CLOCK) != 0,
+                         });
+}
+
+void WlWindow::feedbackHandleDiscarded(void *data, wp_presentation_feedback *) {
+    auto request = (FeedbackRequest *)data;
+    request->window->finishFeedback(request, {.frameIndex = request->frameIndex, .discarded = true});
+}
+
 void WlWindow::xdgSurfaceHandleConfigure(void *data, xdg_surface *surface, u32 serial) {
     auto self = (WlWindow *)data;
     xdg_surface_ack_configure(surface, serial);
-    wl_surface_commit(self->surface);
+    self->commitState();
 }
 
 // This is where we receive resize events
@@ -68,12 +146,12 @@ void WlWindow::toplevelHandleConfigure(void *data, xdg_toplevel *, i32 width, i3
     auto self = (WlWindow *)data;
     if (!width or !height) return;
     self->width = width, self->height = height;
-    self->resizeF(ResizeEvent(width, height));
+    self->pushEvent(ResizeEvent(width, height));
 }
 
 void WlWindow::toplevelHandleClose(void *data, xdg_toplevel *) {
     auto self = (WlWindow *)data;
-    self->exitF();
+    self->pushEvent(CloseEvent());
 }
 
 void WlWindow::toplevelHandleConfigureBounds(void *, xdg_toplevel *, i32, i32) {}
@@ -3,7 +3,10 @@
 #include <wayland-client.h>
 #include <xkbcommon/xkbcommon.h>
 
+#include <mutex>
+
 #include "Core/Core.hpp"
+#include "ThirdParty/wayland/presentation-time.h"
 #include "ThirdParty/wayland/xdg-decoration.h"
 #include "ThirdParty/wayland/xdg-shell.h"
 #include "Window.hpp"
@@ -22,6 +25,16 @@ class WlWindow : public Window {
 
     i32 width = 0, height = 0;
 
+    struct FeedbackRequest {
+        WlWindow* window;
+        wp_presentation_feedback* feedback;
+        u64 frameIndex;
+    };
+    // Requested from the render thread, answered on the thread dispatching the connection
+    std::mutex pendingMutex;
+    Vec<FeedbackRequest*> pendingFeedback;
+    bool commitDeferred = false;  ///< A state change waits for the pending feedback, see commitState
+
    public:
     explicit WlWindow(WlConnection* connection);
     ~WlWindow() override;
@@ -41,7 +54,32 @@ class WlWindow : public Window {
     void resize(u32 width, u32 height) override;
     void setTitle(const String& title) override;
 
+    bool requestPresentFeedback(u64 frameIndex) override;
+
    private:
+    /**
+     * @brief Commits state changes that aren't part of a frame, e.g. acking a configure.
+     *
+     * Feedback attaches to the next commit of the surface, with a submit thread the present making it can be
+     * late. While feedback is pending this doesn't commit, so it can't take the feedback of the frame. The
+     * commit of the frame applies the state as well, if it was already made the commit is made once the
+     * feedback arrived.
+     */
+    void commitState();
+    /// Removes the request from the pending ones and frees it
+    void finishFeedback(FeedbackRequest* request, const PresentFeedback& feedback);
+
+    const wp_presentation_feedback_listener feedbackListener{
+        .sync_output = feedbackHandleSyncOutput,
+        .presented   = feedbackHandlePresented,
+        .discarded   = feedbackHandleDiscarded,
+    };
+    static void feedbackHandleSyncOutput(void* data, wp_presentation_feedback* feedback, wl_output* output);
+    static void feedbackHandlePresented(void* data, wp_presentation_feedback* feedback, u32 tvSecHi,
+                                        u32 tvSecLo, u32 tvNsec, u32 refresh, u32 seqHi, u32 seqLo,
+                                        u32 flags);
+    static void feedbackHandleDiscarded(void* data, wp_presentation_feedback* feedback);
+
     const xdg_surface_listener xdgSurfaceListener{
         .configure = xdgSurfaceHandleConfigure,
     };
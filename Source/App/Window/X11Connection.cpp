@@ -1,19 +1,48 @@
 #include "X11Connection.hpp"
 
+#include <sys/epoll.h>
+#include <xcb/xinput.h>
+#include <xcb/xkb.h>
+#include <xkbcommon/xkbcommon-x11.h>
+
+#include "Core/EventLoop.hpp"
+#include "LinuxCommon.hpp"
 #include "X11Window.hpp"
 
 X11Connection::X11Connection() {
+    context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+
     connection = xcb_connect(nullptr, nullptr);
     if (xcb_connection_has_error(connection)) throw std::runtime_error("Failed to connect to X11 server");
     screen           = xcb_setup_roots_iterator(xcb_get_setup(connection)).data;
     protocolsAtom    = getInternAtom("WM_PROTOCOLS");
     deleteWindowAtom = getInternAtom("WM_DELETE_WINDOW");
+    initRawMotion();
+    initKeyboard();
 }
 
-X11Connection::~X11Connection() { xcb_disconnect(connection); }
+X11Connection::~X11Connection() {
+    xcb_disconnect(connection);
+
+    delete textInput;
+    xkb_state_unref(state);
+    xkb_keymap_unref(keymap);
+    xkb_context_unref(context);
+}
 
 void X11Connection::update() {
-    for (X11Window* w : windows) w->update();
+    // Everything already read is handled before returning, a burst of input never carries over to the next
+    // frame, it is coalesced by the event queues of the windows instead
+    while (xcb_generic_event_t* event = xcb_poll_for_event(connection)) {
+        handleEvent(event);
+        free(event);
+    }
+    // The caller may wait on the fd next, requests left in the buffer would only be sent after the next event
+    xcb_flush(connection);
+}
+
+void X11Connection::addToEventLoop(EventLoop* loop) {
+    loop->addFd(xcb_get_file_descriptor(connection), EPOLLIN, [this](u32) { update(); });
 }
 
 Window* X11Connection::createWindow() { return new X11Window(this, 800, 600); }
@@ -24,4 +53,142 @@ xcb_atom_t X11Connection::getInternAtom(const String& name) {
     xcb_atom_t atom                 = reply->atom;
     delete reply;
     return atom;
-}
\ No newline at end of file
+}
+
+void X11Connection::initRawMotion() {
+    const xcb_query_extension_reply_t* extension = xcb_get_extension_data(connection, &xcb_input_id);
+    if (!extension or !extension->present) return;
+
+    xcb_input_xi_query_version_reply_t* reply =
+        xcb_input_xi_query_version_reply(connection, xcb_input_xi_query_version(connection, 2, 0), nullptr);
+    bool supported = reply and reply->major_version >= 2;
+    free(reply);
+    if (!supported) return;
+
+    struct {
+        xcb_input_event_mask_t head;
+        u32 mask;
+    } mask{};
+    mask.head.deviceid = XCB_INPUT_DEVICE_ALL_MASTER;
+    mask.head.mask_len = 1;
+    mask.mask          = XCB_INPUT_XI_EVENT_MASK_RAW_MOTION;
+    xcb_input_xi_select_events(connection, screen->root, 1, &mask.head);
+    xcb_flush(connection);
+
+    xinputOpcode = extension->major_opcode;
+}
+
+void X11Connection::initKeyboard() {
+    if (!xkb_x11_setup_xkb_extension(connection,
+                                     XKB_X11_MIN_MAJOR_XKB_VERSION,
+                                     XKB_X11_MIN_MINOR_XKB_VERSION,
+                                     XKB_X11_SETUP_XKB_EXTENSION_NO_FLAGS,
+                                     nullptr,
+                                     nullptr,
+                                     &xkbEventBase,
+                                     nullptr))
+        throw std::runtime_error("X11 server doesn't support the XKB extension");
+
+    keyboardDevice = xkb_x11_get_core_keyboard_device_id(connection);
+    if (keyboardDevice == -1) throw std::runtime_error("Failed to get the X11 core keyboard");
+    updateKeymap();
+
+    u16 events = XCB_XKB_EVENT_TYPE_NEW_KEYBOARD_NOTIFY | XCB_XKB_EVENT_TYPE_MAP_NOTIFY |
+                 XCB_XKB_EVENT_TYPE_STATE_NOTIFY;
+    u16 mapParts = XCB_XKB_MAP_PART_KEY_TYPES | XCB_XKB_MAP_PART_KEY_SYMS | XCB_XKB_MAP_PART_MODIFIER_MAP |
+                   XCB_XKB_MAP_PART_EXPLICIT_COMPONENTS | XCB_XKB_MAP_PART_KEY_ACTIONS |
+                   XCB_XKB_MAP_PART_VIRTUAL_MODS | XCB_XKB_MAP_PART_VIRTUAL_MOD_MAP;
+    xcb_xkb_select_events(connection, keyboardDevice, events, 0, events, mapParts, mapParts, nullptr);
+
+    // Held keys then send presses without the release in between
+    u32 autoRepeat = XCB_XKB_PER_CLIENT_FLAG_DETECTABLE_AUTO_REPEAT;
+    free(xcb_xkb_per_client_flags_reply(
+        connection,
+        xcb_xkb_per_client_flags(connection, keyboardDevice, autoRepeat, autoRepeat, 0, 0, 0),
+        nullptr));
+    textInput = new XkbTextInput(context);
+}
+
+void X11Connection::updateKeymap() {
+    xkb_keymap* newKeymap =
+        xkb_x11_keymap_new_from_device(context, connection, keyboardDevice, XKB_KEYMAP_COMPILE_NO_FLAGS);
+    if (!newKeymap) return;  // Keep the previous keymap, better than no keyboard input at all
+
+    // The compose table only depends on the locale, a sequence in progress is dropped with the old keymap
+    if (textInput) textInput->reset();
+    xkb_state_unref(state);
+    xkb_keymap_unref(keymap);
+    keymap = newKeymap;
+    state  = xkb_x11_state_new_from_device(keymap, connection, keyboardDevice);
+
+    shiftIdx    = xkb_keymap_mod_get_index(keymap, XKB_MOD_NAME_SHIFT);
+    ctrlIdx     = xkb_keymap_mod_get_index(keymap, XKB_MOD_NAME_CTRL);
+    altIdx      = xkb_keymap_mod_get_index(keymap, XKB_MOD_NAME_ALT);
+    capsLockIdx = xkb_keymap_mod_get_index(keymap, XKB_MOD_NAME_CAPS);
+    numLockIdx  = xkb_keymap_mod_get_index(keymap, XKB_MOD_NAME_NUM);
+    updateModifiers();
+}
+
+void X11Connection::updateModifiers() {
+    modifiers.setShift(xkb_state_mod_index_is_active(state, shiftIdx, XKB_STATE_MODS_EFFECTIVE));
+    modifiers.setCtrl(xkb_state_mod_index_is_active(state, ctrlIdx, XKB_STATE_MODS_EFFECTIVE));
+    modifiers.setAlt(xkb_state_mod_index_is_active(state, altIdx, XKB_STATE_MODS_EFFECTIVE));
+    modifiers.setCapsLock(xkb_state_mod_index_is_active(state, capsLockIdx, XKB_STATE_MODS_EFFECTIVE));
+    modifiers.setNumLock(xkb_state_mod_index_is_active(state, numLockIdx, XKB_STATE_MODS_EFFECTIVE));
+}
+
+void X11Connection::handleEvent(xcb_generic_event_t* event) {
+    u8 type = event->response_type & ~0x80;
+    if (xkbEventBase and type == xkbEventBase) {
+        handleXkbEvent(event);
+        return;
+    }
+
+    // Only the window the event is about differs between the types, the handling is done by the window
+    X11Window* window = nullptr;
+    switch (type) {
+        case XCB_KEY_PRESS:
+        case XCB_KEY_RELEASE: window = findWindow(((xcb_key_press_event_t*)event)->event); break;
+        case XCB_BUTTON_PRESS:
+        case XCB_BUTTON_RELEASE: window = findWindow(((xcb_button_press_event_t*)event)->event); break;
+        case XCB_MOTION_NOTIFY: window = findWindow(((xcb_motion_notify_event_t*)event)->event); break;
+        case XCB_FOCUS_IN:
+        case XCB_FOCUS_OUT: window = findWindow(((xcb_focus_in_event_t*)event)->event); break;
+        case XCB_CONFIGURE_NOTIFY: window = findWindow(((xcb_configure_notify_event_t*)event)->window); break;
+        case XCB_CLIENT_MESSAGE: window = findWindow(((xcb_client_message_event_t*)event)->window); break;
+        case XCB_GE_GENERIC: window = focusedWindow; break;  // Raw input is selected on the root window
+        default: break;
+    }
+    if (window) window->handleEvent(event);
+}
+
+void X11Connection::handleXkbEvent(xcb_generic_event_t* event) {
+    // All XKB events share one event code, the XKB type is the second byte
+    auto any = (xcb_xkb_new_keyboard_notify_event_t*)event;
+    if (any->deviceID != keyboardDevice) return;
+
+    switch (any->xkbType) {
+        case XCB_XKB_NEW_KEYBOARD_NOTIFY:
+            if (any->changed & XCB_XKB_NKN_DETAIL_KEYCODES) updateKeymap();
+            break;
+        case XCB_XKB_MAP_NOTIFY: updateKeymap(); break;
+        case XCB_XKB_STATE_NOTIFY: {
+            auto stateNotify = (xcb_xkb_state_notify_event_t*)event;
+            xkb_state_update_mask(state,
+                                  stateNotify->baseMods,
+                                  stateNotify->latchedMods,
+                                  stateNotify->lockedMods,
+                                  stateNotify->baseGroup,
+                                  stateNotify->latchedGroup,
+                                  stateNotify->lockedGroup);
+            updateModifiers();
+            break;
+        }
+        default: break;
+    }
+}
+
+X11Window* X11Connection::findWindow(xcb_window_t id) {
+    auto it = windows.find(id);
+    return it == windows.end() ? nullptr : it->second;
+}
@@ -1,12 +1,25 @@
 #pragma once
 
 #include <xcb/xcb.h>
+#include <xkbcommon/xkbcommon.h>
 
+#include <unordered_map>
+
+#include "../Input/Keyboard.hpp"
 #include "Core/Core.hpp"
 #include "WindowConnection.hpp"
 
 class X11Window;
+class XkbTextInput;
 
+/**
+ * @brief Connection to the X server, the only place events are read from.
+ *
+ * update drains every queued event and routes it to its window through a table indexed by the xcb window
+ * id, so the cost per event doesn't depend on the amount of windows. Keys are translated with the xkb keymap
+ * of the core keyboard, which is kept up to date through XKB notify events. The server repeats keys itself,
+ * with detectable auto repeat a repeat is a press of a key that is already down.
+ */
 class X11Connection : public WindowConnection {
     friend class X11Window;
 
@@ -17,16 +30,49 @@ class X11Connection : public WindowConnection {
     xcb_atom_t deleteWindowAtom;
     xcb_atom_t protocolsAtom;
 
-    Vec<X11Window*> windows;
+    u8 xinputOpcode = 0;  ///< Major opcode of XInput 2, 0 if the server doesn't support it
+    u8 xkbEventBase = 0;
+    i32 keyboardDevice{};
+
+    xkb_context* context;
+    xkb_keymap* keymap{};
+    xkb_state* state{};
+
+    u32 shiftIdx{};
+    u32 ctrlIdx{};
+    u32 altIdx{};
+    u32 capsLockIdx{};
+    u32 numLockIdx{};
+    Modifiers modifiers{0};
+    XkbTextInput* textInput{};
+    bool keysDown[256]{};  ///< Indexed by keycode, tells repeats apart from presses
+
+    std::unordered_map<xcb_window_t, X11Window*> windows;
+    X11Window* focusedWindow = nullptr;  ///< Receives raw motion, which is selected on the root window
 
    public:
     X11Connection();
     ~X11Connection() override;
 
     void update() override;
+    void addToEventLoop(EventLoop* loop) override;
 
     Window* createWindow() override;
 
    private:
     xcb_atom_t getInternAtom(const String& name);
+
+    /// Selects XInput 2 raw motion, sent at the full rate of the device and unaffected by screen edges
+    void initRawMotion();
+
+    void initKeyboard();
+    /// Reloads the keymap and state of the core keyboard, on startup and when the layout changes
+    void updateKeymap();
+    void updateModifiers();
+
+    void handleEvent(xcb_generic_event_t* event);
+    void handleXkbEvent(xcb_generic_event_t* event);
+
+    /// Returns nullptr for windows that were already destroyed or don't belong to the connection
+    X11Window* findWindow(xcb_window_t id);
 };
@@ -1,8 +1,11 @@
 #include "X11Window.hpp"
 
+#include <algorithm>
 #include <xcb/xcb.h>
+#include <xcb/xinput.h>
 
 #include "../Input/Event.hpp"
+#include "LinuxCommon.hpp"
 #include "X11Connection.hpp"
 
 X11Window::X11Window(X11Connection* _connection, u32 _width, u32 _height)
@@ -11,13 +14,13 @@ X11Window::X11Window(X11Connection* _connection, u32 _width, u32 _height)
       screen(_connection->screen),
       width(_width),
       height(_height) {
-    connection->windows.push(this);
-
-    id = xcb_generate_id(xcbCon);
+    id                      = xcb_generate_id(xcbCon);
+    connection->windows[id] = this;
 
     u32 mask          = XCB_CW_EVENT_MASK;
     u32 value_list[1] = {XCB_EVENT_MASK_KEY_PRESS | XCB_EVENT_MASK_KEY_RELEASE | XCB_EVENT_MASK_BUTTON_PRESS |
-                         XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_STRUCTURE_NOTIFY};
+                         XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_POINTER_MOTION |
+                         XCB_EVENT_MASK_FOCUS_CHANGE | XCB_EVENT_MASK_STRUCTURE_NOTIFY};
 
     xcb_create_window(xcbCon,
                       XCB_COPY_FROM_PARENT,
@@ -47,31 +50,19 @@ X11Window::X11Window(X11Connection* _connection, u32 _width, u32 _height)
 }
 
 X11Window::~X11Window() {
-    for (u64 i = 0; i < connection->windows.getSize(); i++) {
-        if (connection->windows[i] == this) {
-            connection->windows.remove(i);
-        }
-    }
+    if (connection->focusedWindow == this) connection->focusedWindow = nullptr;
+    connection->windows.erase(id);
     xcb_destroy_window(xcbCon, id);
 }
 
 xcb_connection_t* X11Window::getXcbConnection() { return xcbCon; }
 
-void X11Window::update() {
-    xcb_generic_event_t* event;
-    while (true) {
-        event = xcb_poll_for_event(xcbCon);
-        if (!event) break;
-        handleEvent(event);
-    }
-}
-
 void X11Window::handleEvent(xcb_generic_event_t* event) {
     switch (event->response_type & ~0x80) {
         case XCB_CLIENT_MESSAGE: {
             auto clientMessage = (xcb_client_message_event_t*)event;
             if (clientMessage->data.data32[0] == connection->deleteWindowAtom) {
-                exitF();
+                pushEvent(CloseEvent());
             }
             break;
         }
@@ -80,11 +71,92 @@ void X11Window::handleEvent(xcb_generic_event_t* event) {
             if (configure->width != width or configure->height != height) {
                 width  = configure->width;
                 height = configure->height;
-                resizeF(ResizeEvent(width, height));
+                pushEvent(ResizeEvent(width, height));
+            }
+            break;
+        }
+        case XCB_KEY_PRESS:
+        case XCB_KEY_RELEASE: {
+            auto keyEvent = (xcb_key_press_event_t*)event;
+            u8 keycode    = keyEvent->detail;
+            // X keycodes already are xkb keycodes, the modifiers are tracked from XKB state notify events
+            Key key = xkbKeysymToKey(xkb_state_key_get_one_sym(connection->state, keycode));
+            if ((event->response_type & ~0x80) == XCB_KEY_PRESS) {
+                bool repeat                   = connection->keysDown[keycode];
+                connection->keysDown[keycode] = true;
+                pushEvent(KeyPressedEvent(key, connection->modifiers, repeat));
+                if (const char* text = connection->textInput->keyPressed(connection->state, keycode, repeat))
+                    pushEvent(TextInputEvent(text));
+            } else {
+                connection->keysDown[keycode] = false;
+                pushEvent(KeyReleasedEvent(key, connection->modifiers));
+            }
+            break;
+        }
+        case XCB_BUTTON_PRESS:
+        case XCB_BUTTON_RELEASE: {
+            auto buttonEvent = (xcb_button_press_event_t*)event;
+            MouseButton button;
+            switch (buttonEvent->detail) {
+                case XCB_BUTTON_INDEX_1: button = MouseButton::Left; break;
+                case XCB_BUTTON_INDEX_2: button = MouseButton::Middle; break;
+                case XCB_BUTTON_INDEX_3: button = MouseButton::Right; break;
+                case 8: button = MouseButton::_4; break;
+                case 9: button = MouseButton::_5; break;
+                default: return;  // Buttons 4 to 7 are scroll wheel steps, not buttons, and are ignored
             }
+            if ((event->response_type & ~0x80) == XCB_BUTTON_PRESS)
+                pushEvent(MouseButtonPressedEvent(button));
+            else
+                pushEvent(MouseButtonReleasedEvent(button));
             break;
         }
+        case XCB_MOTION_NOTIFY: {
+            auto motion = (xcb_motion_notify_event_t*)event;
+            pushMotionSample({(f32)motion->event_x, (f32)motion->event_y, (u64)motion->time * 1000});
+            i32 x = motion->event_x, y = motion->event_y;
+            pushEvent(MouseMoveEvent(x, y, x - lastMouseX, y - lastMouseY));
+            lastMouseX = x, lastMouseY = y;
+            break;
+        }
+        case XCB_FOCUS_IN: connection->focusedWindow = this; break;
+        case XCB_FOCUS_OUT:
+            if (connection->focusedWindow == this) connection->focusedWindow = nullptr;
+            // Releases of keys still held go to the window getting the focus
+            std::fill(std::begin(connection->keysDown), std::end(connection->keysDown), false);
+            connection->textInput->reset();
+            break;
+        case XCB_GE_GENERIC: handleRawMotion(event); break;
+    }
+}
+
+static f32 fp3232ToFloat(xcb_input_fp3232_t value) {
+    return (f32)value.integral + (f32)((f64)value.frac / 4294967296.0);
+}
+
+void X11Window::handleRawMotion(xcb_generic_event_t* event) {
+    auto generic = (xcb_ge_generic_event_t*)event;
+    if (connection->xinputOpcode == 0 or generic->extension != connection->xinputOpcode) return;
+    if (generic->event_type != XCB_INPUT_RAW_MOTION) return;
+    // Selected on the root window, so the event names no window
+    X11Window* target = connection->focusedWindow;
+    if (!target) return;
+
+    auto raw                            = (xcb_input_raw_motion_event_t*)event;
+    const u32* mask                     = xcb_input_raw_button_press_valuator_mask(raw);
+    const xcb_input_fp3232_t* values    = xcb_input_raw_button_press_axisvalues(raw);
+    const xcb_input_fp3232_t* rawValues = xcb_input_raw_button_press_axisvalues_raw(raw);
+
+    // Only the valuators set in the mask are sent, in order, valuators 0 and 1 are the x and y axes
+    f32 delta[2]{}, rawDelta[2]{};
+    u32 index = 0;
+    for (u32 valuator = 0; valuator < 2; valuator++) {
+        if (raw->valuators_len == 0 or !(mask[0] & (1u << valuator))) continue;
+        delta[valuator]    = fp3232ToFloat(values[index]);
+        rawDelta[valuator] = fp3232ToFloat(rawValues[index]);
+        index++;
     }
+    if (index > 0) target->pushEvent(MouseRelativeMoveEvent(delta[0], delta[1], rawDelta[0], rawDelta[1]));
 }
 
 void X11Window::show() {
@@ -16,13 +16,12 @@ class X11Window : public Window {
     xcb_window_t id;
 
     u16 width{}, height{};
+    i32 lastMouseX{}, lastMouseY{};
 
    public:
     X11Window(X11Connection* connection, u32 width, u32 height);
     ~X11Window() override;
 
-    void update();
-
     void show() override;
     void hide() override;
     void minimize() override;
@@ -39,4 +38,5 @@ class X11Window : public Window {
 
    private:
     void handleEvent(xcb_generic_event_t* event);
+    void handleRawMotion(xcb_generic_event_t* event);
 };
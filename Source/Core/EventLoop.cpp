@@ -0,0 +1,193 @@
+#include "EventLoop.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <format>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// Events handled per epoll_wait, more stay ready and are returned by the next call
+const i32 MAX_EVENTS = 32;
+
+static timespec toTimespec(std::chrono::nanoseconds ns) {
+    timespec spec{};
+    spec.tv_sec  = (time_t)(ns.count() / 1000000000);
+    spec.tv_nsec = (long)(ns.count() % 1000000000);
+    return spec;
+}
+
+EventLoop::EventLoop() {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1) throw std::runtime_error("Failed to create epoll instance");
+
+    // Registered with a null pointer, which tells it apart from the sources
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event event{};
+    event.events   = EPOLLIN;
+    event.data.ptr = nullptr;
+    if (wakeFd == -1 or epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event) == -1)
+        throw std::runtime_error("Failed to create event loop wake fd");
+}
+
+EventLoop::~EventLoop() {
+    for (auto& [fd, source] : sources) {
+        if (source->timer) close(fd);
+        delete source;
+    }
+    close(wakeFd);
+    close(epollFd);
+}
+
+void EventLoop::addFd(i32 fd, u32 events, const FdCallback& callback) {
+    auto source = new Source{
+        .fd            = fd,
+        .timer         = false,
+        .removed       = false,
+        .fdCallback    = callback,
+        .timerCallback = {},
+    };
+    addSource(source, events);
+}
+
+void EventLoop::modifyFd(i32 fd, u32 events) {
+    auto it = sources.find(fd);
+    if (it == sources.end()) return;
+    epoll_event event{};
+    event.events   = events;
+    event.data.ptr = it->second;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+}
+
+void EventLoop::removeFd(i32 fd) { removeSource(fd); }
+
+i32 EventLoop::addTimer(const TimerCallback& callback) {
+    i32 fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd == -1) throw std::runtime_error("Failed to create timer");
+    auto source = new Source{
+        .fd            = fd,
+        .timer         = true,
+        .removed       = false,
+        .fdCallback    = {},
+        .timerCallback = callback,
+    };
+    addSource(source, EPOLLIN);
+    return fd;
+}
+
+void EventLoop::setTimer(i32 timer, Clock::duration delay, Clock::duration interval) {
+    itimerspec spec{
+        .it_interval = toTimespec(interval),
+        .it_value    = toTimespec(delay),
+    };
+    // A delay rounding down to zero would disarm the timer instead of expiring right away
+    if (delay > Clock::duration::zero() and spec.it_value.tv_sec == 0 and spec.it_value.tv_nsec == 0)
+        spec.it_value.tv_nsec = 1;
+    timerfd_settime(timer, 0, &spec, nullptr);
+}
+
+void EventLoop::setTimerAt(i32 timer, Clock::time_point time) {
+    // A time that already passed expires right away, zero is the only value that disarms
+    auto sinceEpoch = std::max(time.time_since_epoch(), Clock::duration(1));
+    itimerspec spec{
+        .it_interval = {},
+        .it_value    = toTimespec(sinceEpoch),
+    };
+    timerfd_settime(timer, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void EventLoop::removeTimer(i32 timer) {
+    removeSource(timer);
+    close(timer);
+}
+
+void EventLoop::wake() {
+    u64 one = 1;
+    // EAGAIN only happens once the counter is saturated, the loop is woken up then anyway
+    while (write(wakeFd, &one, sizeof(one)) == -1 and errno == EINTR) {}
+}
+
+void EventLoop::post(std::function<void()>&& fn) {
+    {
+        std::lock_guard lock(postMutex);
+        posted.push(std::move(fn));
+    }
+    wake();
+}
+
+u32 EventLoop::poll(i32 timeout) {
+    epoll_event events[MAX_EVENTS];
+    i32 count = epoll_wait(epollFd, events, MAX_EVENTS, timeout);
+    if (count == -1) {
+        if (errno == EINTR) return 0;
+        throw std::runtime_error(std::format("epoll_wait failed with errno {}", errno));
+    }
+
+    u32 callbacks = 0;
+    dispatching   = true;
+    for (i32 i = 0; i < count; i++) {
+        auto source = (Source*)events[i].data.ptr;
+        if (!source) {
+            // Resets the counter, EAGAIN means it was already reset since it became readable
+            u64 value;
+            while (read(wakeFd, &value, sizeof(value)) == -1 and errno == EINTR) {}
+            callbacks += runPosted();
+            continue;
+        }
+        if (source->removed) continue;  // By a callback that ran before
+
+        if (source->timer) {
+            // Nothing to read if the timer was rearmed or disarmed after it became ready
+            u64 expirations;
+            if (read(source->fd, &expirations, sizeof(expirations)) != sizeof(expirations)) continue;
+            source->timerCallback(expirations);
+        } else
+            source->fdCallback(events[i].events);
+        callbacks++;
+    }
+    dispatching = false;
+
+    for (Source* source : removedSources) delete source;
+    removedSources.clear();
+    return callbacks;
+}
+
+void EventLoop::addSource(Source* source, u32 events) {
+    epoll_event event{};
+    event.events   = events;
+    event.data.ptr = source;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, source->fd, &event) == -1) {
+        i32 fd = source->fd;
+        delete source;
+        throw std::runtime_error(std::format("Failed to add fd {} to the event loop", fd));
+    }
+    sources[source->fd] = source;
+}
+
+void EventLoop::removeSource(i32 fd) {
+    auto it = sources.find(fd);
+    if (it == sources.end()) return;
+    Source* source = it->second;
+    sources.erase(it);
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+
+    // The callback of the source may be the one running, it's destroyed once the dispatch is done
+    source->removed = true;
+    if (dispatching)
+        removedSources.push(source);
+    else
+        delete source;
+}
+
+u32 EventLoop::runPosted() {
+    {
+        std::lock_guard lock(postMutex);
+        std::swap(posted, runningPosted);
+    }
+    for (auto& fn : runningPosted) fn();
+    u32 count = (u32)runningPosted.getSize();
+    runningPosted.clear();
+    return count;
+}
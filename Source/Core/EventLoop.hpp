@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+#include "Types.hpp"
+#include "Vec.hpp"
+
+/**
+ * @brief The one place a thread blocks, waiting on file descriptors, timers and wakeups from other threads.
+ *
+ * Built on epoll: sources are registered once instead of being passed to every wait, so a wait costs the same
+ * however many there are. Timers are timerfds and wakeups go through an eventfd, which makes them just more
+ * sources, and a thread blocked in poll uses no CPU until one of them is ready.
+ *
+ * Sources are added, changed and removed from the thread calling poll, also from within their callbacks.
+ * wake and post can be called from any thread.
+ */
+class EventLoop {
+   public:
+    /// Receives the ready epoll events, e.g. EPOLLIN
+    using FdCallback = std::function<void(u32 events)>;
+    /// Receives how often the timer expired since the last call, more than once if poll wasn't called in time
+    using TimerCallback = std::function<void(u64 expirations)>;
+    using Clock         = std::chrono::steady_clock;  ///< CLOCK_MONOTONIC, the clock of the timers
+
+   private:
+    struct Source {
+        i32 fd;
+        bool timer;
+        bool removed = false;
+        FdCallback fdCallback;
+        TimerCallback timerCallback;
+    };
+
+    i32 epollFd;
+    i32 wakeFd;
+    std::unordered_map<i32, Source*> sources;
+    /// Sources removed while dispatching, later events of the same wait may still point to them
+    Vec<Source*> removedSources;
+    bool dispatching = false;
+
+    std::mutex postMutex;
+    Vec<std::function<void()>> posted;
+    Vec<std::function<void()>> runningPosted;  ///< Swapped with posted, so posting never waits on a callback
+
+   public:
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop&)            = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /// Calls callback whenever fd is ready for any of events, level triggered. The caller keeps owning the fd
+    void addFd(i32 fd, u32 events, const FdCallback& callback);
+    void modifyFd(i32 fd, u32 events);
+    void removeFd(i32 fd);
+
+    /// Creates a disarmed timer and returns its id
+    i32 addTimer(const TimerCallback& callback);
+    /**
+     * @brief Arms a timer relative to now.
+     *
+     * @param delay Until the first expiration, 0 disarms the timer.
+     * @param interval Between the following expirations, 0 for a single one.
+     */
+    void setTimer(i32 timer, Clock::duration delay, Clock::duration interval = {});
+    /// Arms a timer to expire once at an absolute time, e.g. the deadline of the next frame
+    void setTimerAt(i32 timer, Clock::time_point time);
+    void removeTimer(i32 timer);
+
+    /// Makes the current or next poll return without waiting
+    void wake();
+    /// Runs fn on the thread calling poll, during its next call
+    void post(std::function<void()>&& fn);
+
+    /**
+     * @brief Waits up to timeout milliseconds for any source, -1 for no limit, and runs their callbacks.
+     *
+     * @return Amount of callbacks that ran, 0 if the wait timed out or was only woken.
+     */
+    u32 poll(i32 timeout);
+
+   private:
+    void addSource(Source* source, u32 events);
+    void removeSource(i32 fd);
+    u32 runPosted();
+};
@@ -0,0 +1,50 @@
+#include "JobSystem.hpp"
+
+JobSystem::JobSystem(u32 workerCount) : workers(workerCount) {
+    for (u32 i = 0; i < workerCount; i++) workers[i] = std::thread([this, i]() { workerLoop(i + 1); });
+}
+
+JobSystem::~JobSystem() {
+    for (u64 i = 0; i < workers.getSize(); i++) jobs.push(Job());
+    for (auto& w : workers) w.join();
+}
+
+void JobSystem::submit(const Job& job) {
+    pending++;
+
+    // Help out instead of blocking when the queue is full, there may be no workers to drain it
+    Job j = job;
+    Job other;
+    while (!jobs.tryPush(std::move(j))) {
+        if (jobs.tryPop(other)) run(other, 0);
+    }
+}
+
+void JobSystem::wait() {
+    Job job;
+    while (u64 p = pending.load()) {
+        if (jobs.tryPop(job))
+            run(job, 0);
+        else
+            pending.wait(p);
+    }
+}
+
+void JobSystem::parallelFor(u32 count, const std::function<void(u32, u32)>& fn) {
+    for (u32 i = 0; i < count; i++) submit([&fn, i](u32 thread) { fn(i, thread); });
+    wait();
+}
+
+void JobSystem::workerLoop(u32 thread) {
+    Job job;
+    while (true) {
+        jobs.pop(job);
+        if (!job) return;
+        run(job, thread);
+    }
+}
+
+void JobSystem::run(const Job& job, u32 thread) {
+    job(thread);
+    if (--pending == 0) pending.notify_all();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#include "MpmcQueue.hpp"
+#include "Types.hpp"
+#include "Vec.hpp"
+
+/**
+ * @brief Fixed pool of worker threads that run submitted jobs.
+ *
+ * Jobs receive the index of the thread running them, which is stable for the lifetime of the job system:
+ * workers are 1 to getThreadCount() - 1 and the thread waiting on the jobs is 0. This allows keeping
+ * per-thread resources, such as command pools, in a plain array.
+ *
+ * submit(), wait() and parallelFor() must all be called from the same thread, which helps running the jobs
+ * while it waits. Jobs go through a lock-free MPMC queue and idle workers sleep on it.
+ */
+class JobSystem {
+   private:
+    using Job = std::function<void(u32 thread)>;
+
+    static constexpr u64 QUEUE_CAPACITY = 1024;
+
+    Vec<std::thread> workers;
+
+    MpmcQueue<Job, QUEUE_CAPACITY> jobs;  ///< An empty job stops the worker popping it
+    std::atomic<u64> pending = 0;         ///< Submitted jobs that haven't finished
+
+   public:
+    /// By default one worker for every hardware thread but the calling one
+    explicit JobSystem(u32 workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&)            = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void submit(const Job& job);
+
+    /// Blocks until every submitted job has finished
+    void wait();
+
+    /// Runs fn(index, thread) for every index in [0, count) and waits for all of them
+    void parallelFor(u32 count, const std::function<void(u32 index, u32 thread)>& fn);
+
+    [[nodiscard]] inline u32 getThreadCount() const { return (u32)workers.getSize() + 1; }
+
+   private:
+    void workerLoop(u32 thread);
+    void run(const Job& job, u32 thread);
+};
@@ -27,6 +27,28 @@ class Rectangle {
     Rectangle viewportTransform(const Rectangle& rect) {
         return {getPosition() + rect.getPosition(), math::min(w, rect.w), math::min(h, rect.h)};
     }
+
+    T getArea() const { return w * h; }
+    bool isEmpty() const { return w <= 0 or h <= 0; }
+
+    bool intersects(const Rectangle& rect) const {
+        return x < rect.x + rect.w and rect.x < x + w and y < rect.y + rect.h and rect.y < y + h;
+    }
+
+    /// Smallest rectangle containing both
+    Rectangle merge(const Rectangle& rect) const {
+        T x0 = math::min(x, rect.x), y0 = math::min(y, rect.y);
+        T x1 = math::max(x + w, rect.x + rect.w), y1 = math::max(y + h, rect.y + rect.h);
+        return {x0, y0, x1 - x0, y1 - y0};
+    }
+
+    /// Overlap of both, empty if they don't intersect
+    Rectangle clip(const Rectangle& rect) const {
+        T x0 = math::max(x, rect.x), y0 = math::max(y, rect.y);
+        T x1 = math::min(x + w, rect.x + rect.w), y1 = math::min(y + h, rect.y + rect.h);
+        if (x1 <= x0 or y1 <= y0) return {};
+        return {x0, y0, x1 - x0, y1 - y0};
+    }
 };
 
 using Rect  = Rectangle<f32>;
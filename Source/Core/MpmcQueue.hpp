@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+#include "Types.hpp"
+
+/**
+ * @brief Bounded lock-free ring queue for any amount of producer and consumer threads.
+ *
+ * Dmitry Vyukov's design: every cell carries a sequence number telling whether it is ready to be written
+ * (sequence == position) or read (sequence == position + 1) for the current lap, so producers and consumers
+ * only contend on their own index with one compare-and-swap per operation, or per batch.
+ *
+ * Waiting sleeps on a separate counter bumped after every publish, since an index can be claimed before the
+ * cell it claims is written and waiting on it could miss the publish.
+ *
+ * @tparam T The type of the elements, moved in and out of preallocated cells.
+ * @tparam CAPACITY Amount of cells, must be a power of two.
+ */
+template <typename T, u64 CAPACITY>
+class MpmcQueue {
+    static_assert(CAPACITY > 1 and (CAPACITY & (CAPACITY - 1)) == 0, "Capacity must be a power of two");
+
+   private:
+    static constexpr u64 MASK = CAPACITY - 1;
+
+    struct Cell {
+        std::atomic<u64> sequence;
+        T data;
+    };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<u64> enqueuePos = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<u64> dequeuePos = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<u32> pushCount  = 0;  ///< Bumped after every publish, for waiting
+    alignas(CACHE_LINE_SIZE) std::atomic<u32> popCount   = 0;
+
+    alignas(CACHE_LINE_SIZE) Cell* cells;
+
+   public:
+    MpmcQueue() : cells(new Cell[CAPACITY]) {
+        for (u64 i = 0; i < CAPACITY; i++) cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    ~MpmcQueue() { delete[] cells; }
+
+    MpmcQueue(const MpmcQueue&)            = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    /// Returns false if the queue is full
+    bool tryPush(T&& x) { return tryPushBatch(&x, 1) == 1; }
+
+    /// Moves up to count elements in as one contiguous range and returns how many were pushed
+    u64 tryPushBatch(T* items, u64 count) {
+        u64 pos = enqueuePos.load(std::memory_order_relaxed);
+        u64 n;
+        while (true) {
+            // Cells ready for this lap stay ready until their position is claimed, which the CAS guards
+            n = 0;
+            while (n < count and readyForPush(pos + n)) n++;
+            if (n == 0) {
+                if (cells[pos & MASK].sequence.load(std::memory_order_acquire) < pos) return 0;  // Full
+                pos = enqueuePos.load(std::memory_order_relaxed);                               // Stale
+                continue;
+            }
+            if (enqueuePos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) break;
+        }
+
+        for (u64 i = 0; i < n; i++) {
+            Cell& cell = cells[(pos + i) & MASK];
+            cell.data  = std::move(items[i]);
+            cell.sequence.store(pos + i + 1, std::memory_order_release);
+        }
+        pushCount.fetch_add(1, std::memory_order_release);
+        pushCount.notify_all();
+        return n;
+    }
+
+    /// Blocks while the queue is full
+    void push(T&& x) {
+        while (true) {
+            u32 pops = popCount.load(std::memory_order_acquire);
+            if (tryPush(std::move(x))) return;
+            popCount.wait(pops);
+        }
+    }
+
+    /// Returns false if the queue is empty
+    bool tryPop(T& x) { return tryPopBatch(&x, 1) == 1; }
+
+    /// Moves up to max elements out as one contiguous range and returns how many were popped
+    u64 tryPopBatch(T* out, u64 max) {
+        u64 pos = dequeuePos.load(std::memory_order_relaxed);
+        u64 n;
+        while (true) {
+            n = 0;
+            while (n < max and readyForPop(pos + n)) n++;
+            if (n == 0) {
+                if (cells[pos & MASK].sequence.load(std::memory_order_acquire) < pos + 1) return 0;  // Empty
+                pos = dequeuePos.load(std::memory_order_relaxed);                                   // Stale
+                continue;
+            }
+            if (dequeuePos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) break;
+        }
+
+        for (u64 i = 0; i < n; i++) {
+            Cell& cell = cells[(pos + i) & MASK];
+            out[i]     = std::move(cell.data);
+            cell.sequence.store(pos + i + CAPACITY, std::memory_order_release);
+        }
+        popCount.fetch_add(1, std::memory_order_release);
+        popCount.notify_all();
+        return n;
+    }
+
+    /// Blocks while the queue is empty
+    void pop(T& x) { popBatch(&x, 1); }
+
+    /// Blocks until at least one element is available and pops up to max elements
+    u64 popBatch(T* out, u64 max) {
+        while (true) {
+            u32 pushes = pushCount.load(std::memory_order_acquire);
+            if (u64 n = tryPopBatch(out, max)) return n;
+            pushCount.wait(pushes);
+        }
+    }
+
+    /// Approximate when called concurrently with push or pop
+    [[nodiscard]] inline u64 getSize() const {
+        u64 enqueued = enqueuePos.load(std::memory_order_acquire);
+        u64 dequeued = dequeuePos.load(std::memory_order_acquire);
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+    [[nodiscard]] static constexpr u64 getCapacity() { return CAPACITY; }
+
+   private:
+    inline bool readyForPush(u64 pos) const {
+        return cells[pos & MASK].sequence.load(std::memory_order_acquire) == pos;
+    }
+    inline bool readyForPop(u64 pos) const {
+        return cells[pos & MASK].sequence.load(std::memory_order_acquire) == pos + 1;
+    }
+};
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include "Iterator.hpp"
+#include "Types.hpp"
+#include "Vec.hpp"
+
+/**
+ * @brief Generational handle to an object stored in a SlotMap.
+ *
+ * Packs a 20 bit slot index and a 12 bit generation into a single u32. The generation is never 0, so a
+ * default constructed handle (value 0) is always the null handle.
+ *
+ * @tparam T The type of the referenced object, only used to make handles of different types distinct.
+ */
+template <typename T>
+class Handle {
+   public:
+    static constexpr u32 INDEX_BITS      = 20;
+    static constexpr u32 INDEX_MASK      = (1u << INDEX_BITS) - 1;
+    static constexpr u32 GENERATION_BITS = 32 - INDEX_BITS;
+    static constexpr u32 GENERATION_MASK = (1u << GENERATION_BITS) - 1;
+
+   private:
+    u32 value = 0;
+
+   public:
+    /// Null handle
+    Handle() = default;
+
+    Handle(u32 index, u32 generation) : value((generation << INDEX_BITS) | (index & INDEX_MASK)) {}
+
+    [[nodiscard]] inline u32 getIndex() const { return value & INDEX_MASK; }
+    [[nodiscard]] inline u32 getGeneration() const { return value >> INDEX_BITS; }
+    [[nodiscard]] inline u32 getValue() const { return value; }
+
+    [[nodiscard]] inline bool isNull() const { return value == 0; }
+    inline explicit operator bool() const { return value != 0; }
+
+    inline bool operator==(const Handle& rhs) const { return value == rhs.value; }
+};
+
+/**
+ * @brief Container that stores objects contiguously and hands out generational handles to them.
+ *
+ * Objects live in a dense array, so iterating over them touches contiguous memory. Handles index a sparse
+ * slot array that points into the dense array. Removing an object moves the last object into its place and
+ * bumps the slot's generation, so stale handles are detected instead of silently aliasing a new object.
+ *
+ * Like Vec, objects are relocated with memcpy when the dense array grows or shrinks, so raw pointers
+ * returned by get() are only valid until the next create() or destroy().
+ *
+ * @tparam T The type of the stored objects.
+ */
+template <typename T>
+class SlotMap {
+   private:
+    static constexpr u32 INVALID = UINT32_MAX;
+
+    struct Slot {
+        u32 denseIndex;  ///< Index into the dense array, or next free slot if the slot is unused
+        u32 generation;
+    };
+
+    T* data      = nullptr;
+    u32 size     = 0;
+    u32 capacity = 0;
+
+    Vec<u32> denseToSlot;
+    Vec<Slot> slots;
+    u32 freeHead = INVALID;
+
+   public:
+    SlotMap() = default;
+
+    ~SlotMap() {
+        clear();
+        ::operator delete(data);
+    }
+
+    SlotMap(const SlotMap&)            = delete;
+    SlotMap& operator=(const SlotMap&) = delete;
+
+    /**
+     * @brief Constructs a new object in place.
+     *
+     * @param args Arguments forwarded to the object's constructor.
+     * @return Handle to the new object.
+     */
+    template <typename... Args>
+    Handle<T> create(Args&&... args) {
+        if (size >= capacity) reallocate(capacity ? capacity * 2 : 16);
+
+        u32 slotIndex;
+        if (freeHead != INVALID) {
+            slotIndex = freeHead;
+            freeHead  = slots[slotIndex].denseIndex;
+        } else {
+            if (slots.getSize() > Handle<T>::INDEX_MASK) throw std::runtime_error("SlotMap is full");
+            slotIndex = (u32)slots.getSize();
+            slots.push({INVALID, 1});
+        }
+
+        std::construct_at(data + size, std::forward<Args>(args)...);
+        slots[slotIndex].denseIndex = size;
+        if (denseToSlot.getSize() > size)
+            denseToSlot[size] = slotIndex;
+        else
+            denseToSlot.push(slotIndex);
+        size++;
+
+        return {slotIndex, slots[slotIndex].generation};
+    }
+
+    /**
+     * @brief Destroys the object referenced by the handle.
+     *
+     * @return false if the handle is null or stale, true otherwise.
+     */
+    bool destroy(Handle<T> handle) {
+        if (!isValid(handle)) return false;
+
+        u32 denseIndex = slots[handle.getIndex()].denseIndex;
+        u32 last       = size - 1;
+
+        std::destroy_at(data + denseIndex);
+        if (denseIndex != last) {  // Move the last object into the hole
+            memcpy((void*)(data + denseIndex), (void*)(data + last), sizeof(T));
+            u32 movedSlot               = denseToSlot[last];
+            denseToSlot[denseIndex]     = movedSlot;
+            slots[movedSlot].denseIndex = denseIndex;
+        }
+        size--;
+
+        releaseSlot(handle.getIndex());
+        return true;
+    }
+
+    /**
+     * @return Whether the handle references a live object.
+     */
+    [[nodiscard]] bool isValid(Handle<T> handle) const {
+        if (handle.isNull() or handle.getIndex() >= slots.getSize()) return false;
+        return slots[handle.getIndex()].generation == handle.getGeneration();
+    }
+
+    /**
+     * @return Pointer to the object, or nullptr if the handle is null or stale.
+     */
+    T* get(Handle<T> handle) {
+        if (!isValid(handle)) return nullptr;
+        return data + slots[handle.getIndex()].denseIndex;
+    }
+
+    const T* get(Handle<T> handle) const {
+        if (!isValid(handle)) return nullptr;
+        return data + slots[handle.getIndex()].denseIndex;
+    }
+
+    /**
+     * @brief Destroys all objects. Every handle handed out so far becomes stale.
+     */
+    void clear() {
+        for (u32 i = 0; i < size; i++) {
+            std::destroy_at(data + i);
+            releaseSlot(denseToSlot[i]);
+        }
+        size = 0;
+    }
+
+    /**
+     * @return Amount of live objects
+     */
+    [[nodiscard]] u32 getSize() const { return size; }
+
+    /**
+     * @return Iterator to the first object of the dense array
+     */
+    [[nodiscard]] Iterator<T> begin() const { return Iterator(data); }
+
+    /**
+     * @return Iterator following the last object of the dense array
+     */
+    [[nodiscard]] Iterator<T> end() const { return Iterator(data + size); }
+
+   private:
+    /// Bumps the slot's generation, invalidating its handles, and puts it on the free list
+    void releaseSlot(u32 slotIndex) {
+        Slot& slot      = slots[slotIndex];
+        slot.generation = (slot.generation + 1) & Handle<T>::GENERATION_MASK;
+        if (slot.generation == 0) slot.generation = 1;
+        slot.denseIndex = freeHead;
+        freeHead        = slotIndex;
+    }
+
+    void reallocate(u32 n) {
+        T* old   = data;
+        capacity = n;
+        data     = (T*)(::operator new(capacity * sizeof(T)));
+        if (old) memcpy((void*)data, (void*)old, size * sizeof(T));
+        ::operator delete(old);
+    }
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+#include "Types.hpp"
+
+/**
+ * @brief Bounded lock-free ring queue for exactly one producer thread and one consumer thread.
+ *
+ * The producer only writes tail and the consumer only writes head, so no operation needs a read-modify-write.
+ * Each side also keeps a cached copy of the other side's index on its own cache line, and only reloads the
+ * shared one when the cached copy says the queue is full or empty.
+ *
+ * The try operations never block. The wait operations sleep on the index of the other side with
+ * std::atomic::wait, which is a futex on Linux and costs nothing when the queue isn't full or empty.
+ *
+ * @tparam T The type of the elements, moved in and out of preallocated slots.
+ * @tparam CAPACITY Amount of slots, must be a power of two.
+ */
+template <typename T, u64 CAPACITY>
+class SpscQueue {
+    static_assert(CAPACITY > 0 and (CAPACITY & (CAPACITY - 1)) == 0, "Capacity must be a power of two");
+
+   private:
+    static constexpr u64 MASK = CAPACITY - 1;
+
+    // Consumer side
+    alignas(CACHE_LINE_SIZE) std::atomic<u64> head = 0;  ///< Next slot to pop
+    u64 cachedTail                                 = 0;
+    // Producer side
+    alignas(CACHE_LINE_SIZE) std::atomic<u64> tail = 0;  ///< Next slot to push
+    u64 cachedHead                                 = 0;
+
+    alignas(CACHE_LINE_SIZE) T* slots;
+
+   public:
+    SpscQueue() : slots(new T[CAPACITY]) {}
+    ~SpscQueue() { delete[] slots; }
+
+    SpscQueue(const SpscQueue&)            = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /// Producer only, returns false if the queue is full
+    bool tryPush(T&& x) { return tryPushBatch(&x, 1) == 1; }
+
+    /// Producer only, moves up to count elements in and returns how many fit
+    u64 tryPushBatch(T* items, u64 count) {
+        u64 t    = tail.load(std::memory_order_relaxed);
+        u64 free = CAPACITY - (t - cachedHead);
+        if (free < count) {
+            cachedHead = head.load(std::memory_order_acquire);
+            free       = CAPACITY - (t - cachedHead);
+        }
+        if (count > free) count = free;
+        if (count == 0) return 0;
+
+        for (u64 i = 0; i < count; i++) slots[(t + i) & MASK] = std::move(items[i]);
+        tail.store(t + count, std::memory_order_release);
+        tail.notify_one();
+        return count;
+    }
+
+    /// Producer only, blocks while the queue is full
+    void push(T&& x) {
+        while (!tryPush(std::move(x))) head.wait(tail.load(std::memory_order_relaxed) - CAPACITY);
+    }
+
+    /// Consumer only, returns false if the queue is empty
+    bool tryPop(T& x) { return tryPopBatch(&x, 1) == 1; }
+
+    /// Consumer only, moves up to max elements out and returns how many were available
+    u64 tryPopBatch(T* out, u64 max) {
+        u64 h         = head.load(std::memory_order_relaxed);
+        u64 available = cachedTail - h;
+        if (available < max) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            available  = cachedTail - h;
+        }
+        if (max > available) max = available;
+        if (max == 0) return 0;
+
+        for (u64 i = 0; i < max; i++) out[i] = std::move(slots[(h + i) & MASK]);
+        head.store(h + max, std::memory_order_release);
+        head.notify_one();
+        return max;
+    }
+
+    /// Consumer only, blocks while the queue is empty
+    void pop(T& x) {
+        while (!tryPop(x)) tail.wait(head.load(std::memory_order_relaxed));
+    }
+
+    /// Consumer only, blocks until at least one element is available and pops up to max elements
+    u64 popBatch(T* out, u64 max) {
+        u64 n;
+        while ((n = tryPopBatch(out, max)) == 0) tail.wait(head.load(std::memory_order_relaxed));
+        return n;
+    }
+
+    /// Approximate when called concurrently with push or pop
+    [[nodiscard]] inline u64 getSize() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+    [[nodiscard]] static constexpr u64 getCapacity() { return CAPACITY; }
+};
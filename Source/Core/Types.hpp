@@ -11,4 +11,7 @@ using i32 = int;
 using i64 = long long;
 
 using f32 = float;
-using f64 = double;
\ No newline at end of file
+using f64 = double;
+
+/// Alignment that keeps data written by different threads from sharing a cache line
+constexpr u64 CACHE_LINE_SIZE = 64;
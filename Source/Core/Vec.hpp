@@ -41,7 +41,7 @@ class Vec {
      */
     Vec(const Vec& v) : size(v.size), capacity(v.size) {
         allocate();
-        memcpy(v.data, data, size * sizeof(T));
+        memcpy(data, v.data, size * sizeof(T));
     }
 
     /**
@@ -93,8 +93,10 @@ class Vec {
         destroy();
         size     = v.size;
         capacity = v.capacity;
-        data     = v.data;
-        v.data   = nullptr;
+        data       = v.data;
+        v.data     = nullptr;
+        v.size     = 0;
+        v.capacity = 0;
         return *this;
     }
 
@@ -131,7 +133,7 @@ class Vec {
      */
     void push(const T& x) {
         if (size >= capacity) reallocate(capacity * 2);
-        data[size] = x;
+        std::construct_at(data + size, x);
         size++;
     }
 
@@ -142,7 +144,7 @@ class Vec {
      */
     void push(T&& x) {
         if (size >= capacity) reallocate(capacity * 2);
-        data[size] = x;
+        std::construct_at(data + size, std::move(x));
         size++;
     }
 
@@ -161,6 +163,21 @@ class Vec {
         size--;
     }
 
+    /**
+     * @brief Remove a range of elements from the container.
+     *
+     * @param begin The index of the first element to remove.
+     * @param end The index following the last element to remove.
+     */
+    void remove(u64 begin, u64 end) {
+        if (begin >= size or begin >= end) return;
+        if (end > size) end = size;
+
+        for (u64 i = begin; i < end; i++) std::destroy_at(data + i);
+        memmove(data + begin, data + end, (size - end) * sizeof(T));
+        size -= end - begin;
+    }
+
     /**
      * @brief Resets the container.
      *
@@ -0,0 +1,107 @@
+#include "BarrierBatch.hpp"
+
+#include <algorithm>
+
+static bool sameRange(const VkImageSubresourceRange& a, const VkImageSubresourceRange& b) {
+    return a.aspectMask == b.aspectMask and a.baseMipLevel == b.baseMipLevel and
+           a.levelCount == b.levelCount and a.baseArrayLayer == b.baseArrayLayer and
+           a.layerCount == b.layerCount;
+}
+
+// VK_REMAINING_MIP_LEVELS and VK_REMAINING_ARRAY_LAYERS are both ~0U and reach to the end of the image,
+// whose size isn't known here
+static bool overlaps(u32 baseA, u32 countA, u32 baseB, u32 countB) {
+    u64 endA = countA == VK_REMAINING_MIP_LEVELS ? UINT64_MAX : (u64)baseA + countA;
+    u64 endB = countB == VK_REMAINING_MIP_LEVELS ? UINT64_MAX : (u64)baseB + countB;
+    return baseA < endB and baseB < endA;
+}
+
+static bool overlapRange(const VkImageSubresourceRange& a, const VkImageSubresourceRange& b) {
+    return (a.aspectMask & b.aspectMask) != 0 and
+           overlaps(a.baseMipLevel, a.levelCount, b.baseMipLevel, b.levelCount) and
+           overlaps(a.baseArrayLayer, a.layerCount, b.baseArrayLayer, b.layerCount);
+}
+
+void BarrierBatch::add(const VkMemoryBarrier2& barrier) {
+    if (!hasMemoryBarrier) {
+        memoryBarrier    = barrier;
+        hasMemoryBarrier = true;
+        return;
+    }
+
+    memoryBarrier.srcStageMask  |= barrier.srcStageMask;
+    memoryBarrier.srcAccessMask |= barrier.srcAccessMask;
+    memoryBarrier.dstStageMask  |= barrier.dstStageMask;
+    memoryBarrier.dstAccessMask |= barrier.dstAccessMask;
+}
+
+void BarrierBatch::add(const VkBufferMemoryBarrier2& barrier) {
+    for (auto& b : bufferBarriers) {
+        if (b.buffer != barrier.buffer or b.srcQueueFamilyIndex != barrier.srcQueueFamilyIndex or
+            b.dstQueueFamilyIndex != barrier.dstQueueFamilyIndex)
+            continue;
+
+        b.srcStageMask  |= barrier.srcStageMask;
+        b.srcAccessMask |= barrier.srcAccessMask;
+        b.dstStageMask  |= barrier.dstStageMask;
+        b.dstAccessMask |= barrier.dstAccessMask;
+
+        // Cover both ranges
+        if (b.size == VK_WHOLE_SIZE or barrier.size == VK_WHOLE_SIZE) {
+            b.offset = std::min(b.offset, barrier.offset);
+            b.size   = VK_WHOLE_SIZE;
+        } else {
+            u64 end  = std::max(b.offset + b.size, barrier.offset + barrier.size);
+            b.offset = std::min(b.offset, barrier.offset);
+            b.size   = end - b.offset;
+        }
+        return;
+    }
+
+    bufferBarriers.push(barrier);
+}
+
+bool BarrierBatch::add(const VkImageMemoryBarrier2& barrier) {
+    for (auto& b : imageBarriers) {
+        if (b.image != barrier.image or !overlapRange(b.subresourceRange, barrier.subresourceRange)) continue;
+
+        // Overlapping transitions can't be in the same dependency, unless they merge into one. Pending
+        // barriers never overlap each other, so no other one can overlap an exact match
+        if (!sameRange(b.subresourceRange, barrier.subresourceRange)) return false;
+
+        // Transitions A -> B and B -> C with nothing recorded in between are the same as A -> C, and an
+        // UNDEFINED old layout discards the contents anyway
+        bool chained = b.newLayout == barrier.oldLayout or barrier.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED;
+        if (!chained or b.srcQueueFamilyIndex != barrier.srcQueueFamilyIndex or
+            b.dstQueueFamilyIndex != barrier.dstQueueFamilyIndex)
+            return false;
+
+        b.newLayout      = barrier.newLayout;
+        b.srcStageMask  |= barrier.srcStageMask;
+        b.srcAccessMask |= barrier.srcAccessMask;
+        b.dstStageMask  |= barrier.dstStageMask;
+        b.dstAccessMask |= barrier.dstAccessMask;
+        return true;
+    }
+
+    imageBarriers.push(barrier);
+    return true;
+}
+
+VkDependencyInfo BarrierBatch::getDependencyInfo() const {
+    return {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount       = getMemoryBarrierCount(),
+        .pMemoryBarriers          = hasMemoryBarrier ? &memoryBarrier : nullptr,
+        .bufferMemoryBarrierCount = getBufferBarrierCount(),
+        .pBufferMemoryBarriers    = bufferBarriers.getData(),
+        .imageMemoryBarrierCount  = getImageBarrierCount(),
+        .pImageMemoryBarriers     = imageBarriers.getData(),
+    };
+}
+
+void BarrierBatch::clear() {
+    hasMemoryBarrier = false;
+    bufferBarriers.clear();
+    imageBarriers.clear();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "Core/Core.hpp"
+
+/**
+ * @brief Collects pipeline barriers so they can be recorded with a single vkCmdPipelineBarrier2.
+ *
+ * Barriers added back to back with no command in between are merged where possible: global barriers are
+ * folded into one, barriers on the same buffer or the same image subresource range have their stage and
+ * access masks combined, and consecutive layout transitions of an image collapse into one.
+ */
+class BarrierBatch {
+   private:
+    VkMemoryBarrier2 memoryBarrier{};
+    bool hasMemoryBarrier = false;
+    Vec<VkBufferMemoryBarrier2> bufferBarriers;
+    Vec<VkImageMemoryBarrier2> imageBarriers;
+
+   public:
+    void add(const VkMemoryBarrier2& barrier);
+    void add(const VkBufferMemoryBarrier2& barrier);
+
+    /**
+     * @brief Adds an image barrier, merging it with a pending barrier on the same subresources if possible.
+     *
+     * @return false if the barrier conflicts with a pending one, i.e. it overlaps a pending barrier of the
+     * image without being a chained transition of the exact same range. The batch then has to be recorded
+     * before the barrier is added again.
+     */
+    bool add(const VkImageMemoryBarrier2& barrier);
+
+    /// The returned struct points into the batch and is valid until the batch is modified
+    [[nodiscard]] VkDependencyInfo getDependencyInfo() const;
+
+    void clear();
+
+    [[nodiscard]] inline bool isEmpty() const {
+        return !hasMemoryBarrier and bufferBarriers.getSize() == 0 and imageBarriers.getSize() == 0;
+    }
+    [[nodiscard]] inline u32 getMemoryBarrierCount() const { return hasMemoryBarrier ? 1 : 0; }
+    [[nodiscard]] inline u32 getBufferBarrierCount() const { return (u32)bufferBarriers.getSize(); }
+    [[nodiscard]] inline u32 getImageBarrierCount() const { return (u32)imageBarriers.getSize(); }
+};
@@ -25,13 +25,13 @@ class Buffer {
     inline VkBuffer getVkBuffer() { return buffer; }
     inline VmaAllocation getVmaAllocation() { return allocation; }
     [[nodiscard]] inline u64 getSize() const { return size; }
+    /// Mapped pointer, nullptr if the buffer was not created with VMA_ALLOCATION_CREATE_MAPPED_BIT
+    [[nodiscard]] inline void* getData() const { return allocationInfo.pMappedData; }
 };
 
 class CpuVisibleBuffer : public Buffer {
    public:
     CpuVisibleBuffer(Device* device, u64 size, VkBufferUsageFlags usage);
-
-    [[nodiscard]] inline void* getData() const { return allocationInfo.pMappedData; }
 };
 
 class GpuLocalBuffer : public Buffer {
@@ -8,12 +8,52 @@
 CmdPool::CmdPool(Device *_device, VkCommandPool _pool, bool _owned)
     : device(_device), pool(_pool), owned(_owned) {}
 
+CmdPool::CmdPool(Device *_device, u32 queueFamily) : device(_device), owned(true) {
+    VkCommandPoolCreateInfo createInfo{
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = queueFamily,
+    };
+    vkCreateCommandPool(device->getVkDevice(), &createInfo, nullptr, &pool);
+}
+
 CmdPool::~CmdPool() {
+    for (CmdBuffer *c : primaryBuffers) delete c;
+    for (CmdBuffer *c : secondaryBuffers) delete c;
+
     if (owned) {
         vkDestroyCommandPool(device->getVkDevice(), pool, nullptr);
     }
 }
 
+CmdBuffer *CmdPool::allocate(VkCommandBufferLevel level) {
+    bool primary              = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    Vec<CmdBuffer *> &buffers = primary ? primaryBuffers : secondaryBuffers;
+    u32 &used                 = primary ? usedPrimary : usedSecondary;
+
+    if (used == buffers.getSize()) buffers.push(new CmdBuffer(this, level));
+    return buffers[used++];
+}
+
+void CmdPool::reset() {
+    vkResetCommandPool(device->getVkDevice(), pool, 0);
+    usedPrimary = usedSecondary = 0;
+}
+
+FrameCmdPools::FrameCmdPools(Device *device, u32 queueFamily, u32 _threadCount, u32 _frameCount)
+    : threadCount(_threadCount), frameCount(_frameCount) {
+    for (u32 i = 0; i < threadCount * frameCount; i++) pools.push(new CmdPool(device, queueFamily));
+}
+
+FrameCmdPools::~FrameCmdPools() {
+    for (CmdPool *p : pools) delete p;
+}
+
+void FrameCmdPools::beginFrame() {
+    frame = (frame + 1) % frameCount;
+    for (u32 i = 0; i < threadCount; i++) getPool(i)->reset();
+}
+
 CmdBuffer::CmdBuffer(CmdPool *_cmdPool, VkCommandBufferLevel _level)
     : device(_cmdPool->getDevice()), cmdPool(_cmdPool), level(_level) {
     VkCommandBufferAllocateInfo allocateInfo{
@@ -37,6 +77,37 @@ void CmdBuffer::begin(bool oneTimeSubmit) {
     };
     if (oneTimeSubmit) beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+
+    pendingBarriers.clear();
+    barrierStats    = {};
+    insideRendering = false;
+}
+
+void CmdBuffer::beginSecondary(const Vec<VkFormat> &colorFormats, VkFormat depthFormat,
+                               VkSampleCountFlagBits samples) {
+    VkCommandBufferInheritanceRenderingInfo renderingInfo{
+        .sType                   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+        .colorAttachmentCount    = (u32)colorFormats.getSize(),
+        .pColorAttachmentFormats = colorFormats.getData(),
+        .depthAttachmentFormat   = depthFormat,
+        .stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+        .rasterizationSamples    = samples,
+    };
+    VkCommandBufferInheritanceInfo inheritanceInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext = &renderingInfo,
+    };
+    VkCommandBufferBeginInfo beginInfo{
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                            VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &inheritanceInfo,
+    };
+    vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+
+    pendingBarriers.clear();
+    barrierStats    = {};
+    insideRendering = true;
 }
 
 void CmdBuffer::defaultState() {
@@ -58,9 +129,15 @@ void CmdBuffer::defaultState() {
     setColorWriteMask(0, {COLOR_COMPONENTS_ALL});
 }
 
-void CmdBuffer::end() { vkEndCommandBuffer(cmdBuffer); }
+void CmdBuffer::end() {
+    flushBarriers();
+    vkEndCommandBuffer(cmdBuffer);
+}
 
 void CmdBuffer::beginRendering(const RenderingInfo &info) {
+    flushBarriers();
+    insideRendering = true;
+
     Vec<VkRenderingAttachmentInfo> colorAttachments;
     for (const auto &a : info.colorAttachments) colorAttachments.push(a.getVkInfo());
     VkRenderingAttachmentInfo depthAttachment   = info.depthAttachment.getVkInfo();
@@ -75,43 +152,78 @@ void CmdBuffer::beginRendering(const RenderingInfo &info) {
         .pDepthAttachment     = &depthAttachment,
         .pStencilAttachment   = &stencilAttachment,
     };
+    if (info.secondaryContents) renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
 
     vkCmdBeginRendering(cmdBuffer, &renderingInfo);
 }
 
-void CmdBuffer::endRendering() { vkCmdEndRendering(cmdBuffer); }
+void CmdBuffer::endRendering() {
+    vkCmdEndRendering(cmdBuffer);
+    insideRendering = false;
+}
+
+void CmdBuffer::executeCommands(const Vec<CmdBuffer *> &secondaryBuffers) {
+    Vec<VkCommandBuffer> buffers;
+    for (CmdBuffer *c : secondaryBuffers) buffers.push(c->getVkCommandBuffer());
+    flushBarriers();
+    vkCmdExecuteCommands(cmdBuffer, buffers.getSize(), buffers.getData());
+}
 
 void CmdBuffer::draw(u32 vertexCount, u32 instanceCount, u32 firstVertex, u32 firstInstance) {
+    flushBarriers();
     vkCmdDraw(cmdBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
 }
 
 void CmdBuffer::drawIndexed(u32 indexCount, u32 instanceCount, u32 firstIndex, i32 vertexOffset,
                             u32 firstInstance) {
+    flushBarriers();
     vkCmdDrawIndexed(cmdBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
 }
 
+void CmdBuffer::dispatch(u32 groupCountX, u32 groupCountY, u32 groupCountZ) {
+    flushBarriers();
+    vkCmdDispatch(cmdBuffer, groupCountX, groupCountY, groupCountZ);
+}
+
+void CmdBuffer::dispatchIndirect(Buffer *buffer, u64 offset) {
+    flushBarriers();
+    vkCmdDispatchIndirect(cmdBuffer, buffer->getVkBuffer(), offset);
+}
+
 void CmdBuffer::copyBuffer(Buffer *src, Buffer *dst, u64 size, u64 srcOffset, u64 dstOffset) {
     VkBufferCopy copy{
         .srcOffset = srcOffset,
         .dstOffset = dstOffset,
         .size      = size,
     };
+    flushBarriers();
     vkCmdCopyBuffer(cmdBuffer, src->getVkBuffer(), dst->getVkBuffer(), 1, &copy);
 }
 
-void CmdBuffer::pushConstant(Shader *shader, u32 offset, u32 size, void *data) {
-    vkCmdPushConstants(cmdBuffer, shader->getVkPipelineLayout(), shader->getStage(), offset, size, data);
+void CmdBuffer::pushConstant(Shader *shader, u32 offset, u32 size, const void *data) {
+    pushConstant(shader->getVkPipelineLayout(), shader->getStage(), offset, size, data);
+}
+
+void CmdBuffer::pushConstant(VkPipelineLayout layout, VkShaderStageFlags stages, u32 offset, u32 size,
+                             const void *data) {
+    vkCmdPushConstants(cmdBuffer, layout, stages, offset, size, data);
 }
 
 void CmdBuffer::bindShader(VkShaderStageFlagBits stage, Shader *shader) {
-    VkShaderEXT s = shader->getVkShader();
-    device->vkCmdBindShadersEXT(cmdBuffer, 1, &stage, &s);
+    bindShader(stage, shader->getVkShader());
+}
+
+void CmdBuffer::bindShader(VkShaderStageFlagBits stage, VkShaderEXT shader) {
+    device->vkCmdBindShadersEXT(cmdBuffer, 1, &stage, &shader);
 }
 
 void CmdBuffer::bindVertexBuffer(Buffer *buffer, u32 bindingIndex) {
-    VkBuffer buf = buffer ? buffer->getVkBuffer() : nullptr;
-    u64 offset   = 0;
-    vkCmdBindVertexBuffers(cmdBuffer, bindingIndex, 1, &buf, &offset);
+    bindVertexBuffer(buffer ? buffer->getVkBuffer() : nullptr, bindingIndex);
+}
+
+void CmdBuffer::bindVertexBuffer(VkBuffer buffer, u32 bindingIndex) {
+    u64 offset = 0;
+    vkCmdBindVertexBuffers(cmdBuffer, bindingIndex, 1, &buffer, &offset);
 }
 
 void CmdBuffer::bindIndexBuffer(Buffer *buffer, VkIndexType indexType) {
@@ -130,15 +242,61 @@ void CmdBuffer::bindDescriptorBuffers(const Vec<DescriptorBufferBindingInfo> &bi
     device->vkCmdBindDescriptorBuffersEXT(cmdBuffer, vkBindingInfos.getSize(), vkBindingInfos.getData());
 }
 
+void CmdBuffer::setDescriptorBufferOffsets(VkPipelineBindPoint bindPoint, Shader *shader, u32 firstSet,
+                                           const Vec<u32> &bufferIndices, const Vec<u64> &offsets) {
+    device->vkCmdSetDescriptorBufferOffsetsEXT(cmdBuffer,
+                                               bindPoint,
+                                               shader->getVkPipelineLayout(),
+                                               firstSet,
+                                               bufferIndices.getSize(),
+                                               bufferIndices.getData(),
+                                               offsets.getData());
+}
+
+// Dynamic rendering only allows barriers for local read dependencies, which aren't used
+static void checkOutsideRendering(bool insideRendering) {
+    if (insideRendering) throw std::runtime_error("Pipeline barriers can't be recorded inside a render pass");
+}
+
+void CmdBuffer::memoryBarrier(VkMemoryBarrier2 barrier) {
+    checkOutsideRendering(insideRendering);
+    pendingBarriers.add(barrier);
+}
+
+void CmdBuffer::bufferMemoryBarrier(VkBufferMemoryBarrier2 barrier) {
+    checkOutsideRendering(insideRendering);
+    pendingBarriers.add(barrier);
+}
+
 void CmdBuffer::imageMemoryBarrier(VkImageMemoryBarrier2 barrier) {
-    VkDependencyInfo info{
-        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-        .memoryBarrierCount       = 0,
-        .bufferMemoryBarrierCount = 0,
-        .imageMemoryBarrierCount  = 1,
-        .pImageMemoryBarriers     = &barrier,
-    };
+    checkOutsideRendering(insideRendering);
+    if (pendingBarriers.add(barrier)) return;
+
+    // Conflicts with a pending transition of the same subresources, record the pending ones first
+    flushBarriers();
+    pendingBarriers.add(barrier);
+}
+
+void CmdBuffer::pipelineBarrier(const Vec<VkMemoryBarrier2> &memoryBarriers,
+                                const Vec<VkBufferMemoryBarrier2> &bufferBarriers,
+                                const Vec<VkImageMemoryBarrier2> &imageBarriers) {
+    for (const auto &b : memoryBarriers) memoryBarrier(b);
+    for (const auto &b : bufferBarriers) bufferMemoryBarrier(b);
+    for (const auto &b : imageBarriers) imageMemoryBarrier(b);
+}
+
+void CmdBuffer::flushBarriers() {
+    // Nothing can be pending inside a render pass, beginRendering flushed and no barrier was added since
+    if (pendingBarriers.isEmpty()) return;
+
+    VkDependencyInfo info = pendingBarriers.getDependencyInfo();
     vkCmdPipelineBarrier2(cmdBuffer, &info);
+
+    barrierStats.pipelineBarriers++;
+    barrierStats.memoryBarriers += pendingBarriers.getMemoryBarrierCount();
+    barrierStats.bufferBarriers += pendingBarriers.getBufferBarrierCount();
+    barrierStats.imageBarriers  += pendingBarriers.getImageBarrierCount();
+    pendingBarriers.clear();
 }
 
 void CmdBuffer::setViewport(VkViewport viewport) { vkCmdSetViewportWithCount(cmdBuffer, 1, &viewport); }
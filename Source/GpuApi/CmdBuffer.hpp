@@ -2,10 +2,12 @@
 
 #include <vulkan/vulkan.h>
 
+#include "BarrierBatch.hpp"
 #include "Common.hpp"
 
 class Device;
 class Buffer;
+class CmdBuffer;
 
 class CmdPool {
     friend Device;
@@ -15,17 +17,67 @@ class CmdPool {
     VkCommandPool pool;
     const bool owned;
 
+    // Command buffers handed out by allocate(), reused after reset()
+    Vec<CmdBuffer*> primaryBuffers;
+    Vec<CmdBuffer*> secondaryBuffers;
+    u32 usedPrimary   = 0;
+    u32 usedSecondary = 0;
+
     CmdPool(Device* device, VkCommandPool pool, bool _owned = true);
 
    public:
+    /**
+     * @brief Creates a pool whose command buffers are reset all at once with reset().
+     *
+     * Like any Vulkan command pool it must only be used by one thread at a time, see FrameCmdPools.
+     */
+    CmdPool(Device* device, u32 queueFamily);
     ~CmdPool();
 
+    /// Returns a command buffer owned by the pool, valid until the pool is destroyed
+    CmdBuffer* allocate(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+    /// Resets every command buffer of the pool, the GPU must be done executing them
+    void reset();
+
     inline Device* getDevice() { return device; }
     inline VkCommandPool getVkCommandPool() { return pool; }
 };
 
+/**
+ * @brief Command pools for every pair of frame in flight and recording thread.
+ *
+ * Every thread records into its own pool, so no locking is needed, and all command buffers of a frame are
+ * recycled with one vkResetCommandPool per thread instead of being freed one by one.
+ */
+class FrameCmdPools {
+   private:
+    u32 threadCount;
+    u32 frameCount;
+    u32 frame = 0;
+    Vec<CmdPool*> pools;
+
+   public:
+    FrameCmdPools(Device* device, u32 queueFamily, u32 threadCount, u32 frameCount = 1);
+    ~FrameCmdPools();
+
+    /// Switches to the pools of the next frame and resets them, the GPU must be done with that frame
+    void beginFrame();
+
+    inline CmdPool* getPool(u32 thread) { return pools[frame * threadCount + thread]; }
+    [[nodiscard]] inline u32 getThreadCount() const { return threadCount; }
+};
+
 class Shader;
 
+/// Barriers recorded since the last begin()
+struct BarrierStats {
+    u32 pipelineBarriers;  ///< vkCmdPipelineBarrier2 calls
+    u32 memoryBarriers;
+    u32 bufferBarriers;
+    u32 imageBarriers;
+};
+
 class CmdBuffer {
    private:
     Device* device;
@@ -33,6 +85,10 @@ class CmdBuffer {
     VkCommandBufferLevel level;
     VkCommandBuffer cmdBuffer{};
 
+    BarrierBatch pendingBarriers;
+    BarrierStats barrierStats{};
+    bool insideRendering = false;
+
    public:
     explicit CmdBuffer(CmdPool* cmdPool, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
     ~CmdBuffer();
@@ -40,22 +96,44 @@ class CmdBuffer {
     // Basic
     void reset();
     void begin(bool oneTimeSubmit = false);
+    /// Begins a secondary command buffer that continues a render pass begun with secondary contents
+    void beginSecondary(const Vec<VkFormat>& colorFormats, VkFormat depthFormat = VK_FORMAT_UNDEFINED,
+                        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
     void defaultState();
     void end();
     void beginRendering(const RenderingInfo& info);
     void endRendering();
+    void executeCommands(const Vec<CmdBuffer*>& secondaryBuffers);
     void draw(u32 vertexCount, u32 instanceCount, u32 firstVertex, u32 firstInstance);
     void drawIndexed(u32 indexCount, u32 instanceCount, u32 firstIndex, i32 vertexOffset, u32 firstInstance);
+    void dispatch(u32 groupCountX, u32 groupCountY = 1, u32 groupCountZ = 1);
+    void dispatchIndirect(Buffer* buffer, u64 offset = 0);
     void copyBuffer(Buffer* src, Buffer* dst, u64 size, u64 srcOffset = 0, u64 dstOffset = 0);
-    void pushConstant(Shader* shader, u32 offset, u32 size, void* data);
-
+    void pushConstant(Shader* shader, u32 offset, u32 size, const void* data);
+    void pushConstant(VkPipelineLayout layout, VkShaderStageFlags stages, u32 offset, u32 size,
+                      const void* data);
+
+    // Barriers are batched and recorded as a single vkCmdPipelineBarrier2 before the next draw, dispatch,
+    // copy, beginRendering or end. They can't be added inside a render pass, which throws
+    void memoryBarrier(VkMemoryBarrier2 barrier);
+    void bufferMemoryBarrier(VkBufferMemoryBarrier2 barrier);
     void imageMemoryBarrier(VkImageMemoryBarrier2 barrier);
-
-    // Binding
+    void pipelineBarrier(const Vec<VkMemoryBarrier2>& memoryBarriers,
+                         const Vec<VkBufferMemoryBarrier2>& bufferBarriers,
+                         const Vec<VkImageMemoryBarrier2>& imageBarriers);
+    /// Records the pending barriers now
+    void flushBarriers();
+
+    // Binding. The overloads taking Vulkan handles don't touch the device pools, so they can be used without
+    // holding Device::lockObjects
     void bindShader(VkShaderStageFlagBits stage, Shader* shader);
+    void bindShader(VkShaderStageFlagBits stage, VkShaderEXT shader);
     void bindVertexBuffer(Buffer* buffer, u32 bindingIndex);
+    void bindVertexBuffer(VkBuffer buffer, u32 bindingIndex);
     void bindIndexBuffer(Buffer* buffer, VkIndexType indexType);
     void bindDescriptorBuffers(const Vec<DescriptorBufferBindingInfo>& bindingInfos);
+    void setDescriptorBufferOffsets(VkPipelineBindPoint bindPoint, Shader* shader, u32 firstSet,
+                                    const Vec<u32>& bufferIndices, const Vec<u64>& offsets);
 
     void setViewport(VkViewport viewport);
     void setScissor(VkRect2D scissor);
@@ -89,6 +167,8 @@ class CmdBuffer {
     void setColorBlendEquation(u32 attachment, VkColorBlendEquationEXT equation);
     void setColorWriteMask(u32 firstAttachment, const Vec<VkColorComponentFlags>& masks);
 
+    [[nodiscard]] inline const BarrierStats& getBarrierStats() const { return barrierStats; }
+
     inline Device* getDevice() { return device; }
     inline VkCommandBuffer getVkCommandBuffer() { return cmdBuffer; }
 };
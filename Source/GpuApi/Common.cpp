@@ -3,7 +3,7 @@
 #include "Image.hpp"
 
 VkRenderingAttachmentInfo RenderingAttachment::getVkInfo() const {
-    VkImageView view        = imageView ? imageView->getVkImageView() : nullptr;
+    VkImageView view        = imageView ? imageView->getVkImageView() : vkImageView;
     VkImageView resolveView = resolveImageView ? resolveImageView->getVkImageView() : nullptr;
     return {
         .sType              = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
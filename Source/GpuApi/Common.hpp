@@ -4,13 +4,35 @@
 #include <vulkan/vulkan.h>
 
 #include "Core/Core.hpp"
+#include "Core/SlotMap.hpp"
 
 class DescriptorSetLayout;
+class Buffer;
+class Image;
 class ImageView;
+class Shader;
+class Semaphore;
+class CmdBuffer;
+class Fence;
+
+using BufferHandle    = Handle<Buffer>;
+using ImageHandle     = Handle<Image>;
+using ImageViewHandle = Handle<ImageView>;
+using ShaderHandle    = Handle<Shader>;
+using SemaphoreHandle = Handle<Semaphore>;
 
 const u32 COLOR_COMPONENTS_ALL =
     VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
 
+struct DeviceConfig {
+    /// Skips the surface and swapchain extensions, for compute-only and offscreen work
+    bool headless = false;
+    /// Index or part of the name of the physical device to use, overrides the XV_DEVICE environment variable
+    String preferredDevice;
+    /// Submits and presents on the graphics queue from a dedicated thread, see Queue::startSubmitThread
+    bool submitThread = false;
+};
+
 struct SurfaceConfig {
     VkFormat format;
     VkColorSpaceKHR colorSpace;
@@ -18,11 +40,25 @@ struct SurfaceConfig {
     u32 width, height;
 };
 
+struct SemaphoreSubmitInfo {
+    Semaphore* semaphore;
+    u64 value;  ///< Ignored for binary semaphores
+    VkPipelineStageFlags2 stageMask;
+};
+
+struct SubmitInfo {
+    Vec<CmdBuffer*> cmdBuffers;
+    Vec<SemaphoreSubmitInfo> waitSemaphores;
+    Vec<SemaphoreSubmitInfo> signalSemaphores;
+    Fence* fence;
+};
+
 struct ShaderDesc {
     VkShaderStageFlagBits stage;
     VkShaderStageFlags nextStage;
     VkShaderCodeTypeEXT codeType;
-    Vec<u8> code;
+    const void* code;  ///< Only read during creation, e.g. an array embedded by the Shaders target
+    u64 codeSize;      ///< In bytes
     const char* name;
     Vec<DescriptorSetLayout*> setLayouts;
     Vec<VkPushConstantRange> pushConstantRanges;
@@ -30,6 +66,7 @@ struct ShaderDesc {
 
 struct RenderingAttachment {
     ImageView* imageView;
+    VkImageView vkImageView;  ///< Used if imageView is null, e.g. from RenderGraph::getVkImageView
     VkImageLayout imageLayout;
     VkAttachmentLoadOp loadOp;
     VkAttachmentStoreOp storeOp;
@@ -46,6 +83,8 @@ struct RenderingInfo {
     Vec<RenderingAttachment> colorAttachments;
     RenderingAttachment depthAttachment;
     RenderingAttachment stencilAttachment;
+    /// Commands of the render pass are recorded in secondary command buffers, see CmdBuffer::executeCommands
+    bool secondaryContents;
 };
 
 struct VertexBinding {
@@ -0,0 +1,21 @@
+#include "DeletionQueue.hpp"
+
+DeletionQueue::~DeletionQueue() { flush(); }
+
+void DeletionQueue::push(const SyncPoint& syncPoint, const std::function<void()>& destroy) {
+    entries.push({.syncPoint = syncPoint, .destroy = destroy});
+}
+
+void DeletionQueue::collect(const SyncPoint& completed) {
+    u64 count = 0;
+    while (count < entries.getSize() and entries[count].syncPoint.isReachedBy(completed)) {
+        entries[count].destroy();
+        count++;
+    }
+    entries.remove(0, count);
+}
+
+void DeletionQueue::flush() {
+    for (auto& e : entries) e.destroy();
+    entries.clear();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Core/Core.hpp"
+
+/**
+ * @brief Timeline values of the graphics, compute and transfer queues.
+ */
+struct SyncPoint {
+    u64 graphics = 0;
+    u64 compute  = 0;
+    u64 transfer = 0;
+
+    /// Whether every queue has reached its value in this sync point
+    [[nodiscard]] inline bool isReachedBy(const SyncPoint& completed) const {
+        return graphics <= completed.graphics and compute <= completed.compute and
+               transfer <= completed.transfer;
+    }
+};
+
+/**
+ * @brief Queue of destruction callbacks that run once the GPU has reached a given sync point.
+ *
+ * Entries must be pushed with non-decreasing sync points, which is the case when they are keyed to the
+ * monotonically increasing queue timelines. Entries with the same sync point run in push order.
+ */
+class DeletionQueue {
+   private:
+    struct Entry {
+        SyncPoint syncPoint;
+        std::function<void()> destroy;
+    };
+
+    Vec<Entry> entries;
+
+   public:
+    DeletionQueue() = default;
+    ~DeletionQueue();
+
+    DeletionQueue(const DeletionQueue&)            = delete;
+    DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+    void push(const SyncPoint& syncPoint, const std::function<void()>& destroy);
+
+    /// Runs every entry whose sync point has been reached by completed
+    void collect(const SyncPoint& completed);
+
+    /// Runs every entry regardless of its sync point, the GPU must be idle
+    void flush();
+
+    [[nodiscard]] inline u64 getSize() const { return entries.getSize(); }
+};
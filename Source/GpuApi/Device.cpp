@@ -1,5 +1,7 @@
 #include "Device.hpp"
 
+#include <cstdlib>
+#include <cstring>
 #include <vulkan/vulkan.h>
 
 #include "CmdBuffer.hpp"
@@ -10,7 +12,7 @@ static const Vec<const char*> enabledLayers = {
     "VK_LAYER_KHRONOS_validation",
 #endif
 };
-static const Vec<const char*> instanceExtensions = {
+static const Vec<const char*> surfaceInstanceExtensions = {
     "VK_KHR_surface",
 #ifdef __linux__
     "VK_KHR_xcb_surface",
@@ -18,16 +20,71 @@ static const Vec<const char*> instanceExtensions = {
 #endif
 };
 static const Vec<const char*> deviceExtensions = {
-    "VK_KHR_swapchain",
     "VK_EXT_shader_object",
     "VK_EXT_extended_dynamic_state3",
     "VK_EXT_descriptor_buffer",
     "VK_EXT_line_rasterization",
 };
+static const char* swapchainExtension          = "VK_KHR_swapchain";
+static const char* presentIdExtension          = "VK_KHR_present_id";
+static const char* presentWaitExtension        = "VK_KHR_present_wait";
+static const char* incrementalPresentExtension = "VK_KHR_incremental_present";
+
+static Vec<VkExtensionProperties> getDeviceExtensions(VkPhysicalDevice pd) {
+    u32 extensionCount;
+    vkEnumerateDeviceExtensionProperties(pd, nullptr, &extensionCount, nullptr);
+    Vec<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(pd, nullptr, &extensionCount, extensions.getData());
+    return extensions;
+}
+
+static bool hasExtension(const Vec<VkExtensionProperties>& extensions, const char* name) {
+    for (const auto& e : extensions)
+        if (std::strcmp(e.extensionName, name) == 0) return true;
+    return false;
+}
+
+// Device type first (discrete > integrated > virtual > CPU), then the amount of device local memory
+static u64 scoreDevice(VkPhysicalDevice pd) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(pd, &properties);
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(pd, &memoryProperties);
+
+    u64 typeScore = 0;
+    switch (properties.deviceType) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: typeScore = 4; break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: typeScore = 3; break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: typeScore = 2; break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU: typeScore = 1; break;
+        default: break;
+    }
+
+    u64 localMemory = 0;
+    for (u32 i = 0; i < memoryProperties.memoryHeapCount; i++) {
+        const VkMemoryHeap& heap = memoryProperties.memoryHeaps[i];
+        if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) localMemory += heap.size;
+    }
+
+    // Memory in MiB stays far below 2^40
+    return (typeScore << 40) | (localMemory >> 20);
+}
+
+// The override is either an index into the enumerated devices or a part of the device name
+static bool matchesOverride(const char* preferred, u32 index, VkPhysicalDevice pd) {
+    char* end;
+    u64 preferredIndex = std::strtoull(preferred, &end, 10);
+    if (end != preferred and *end == 0) return preferredIndex == index;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(pd, &properties);
+    return std::strstr(properties.deviceName, preferred) != nullptr;
+}
 
-Device::Device() {
+Device::Device(const DeviceConfig& _config) : config(_config) {
     createInstance();
     pickPhysicalDevice();
+    setupOptionalExtensions();
     setupQueueCreateInfos();
     createDevice();
     createAllocator();
@@ -36,13 +93,22 @@ Device::Device() {
 }
 
 Device::~Device() {
+    waitIdle();
+    deletionQueue.flush();
+
+    semaphores.clear();
+    shaders.clear();
+    imageViews.clear();
+    images.clear();
+    buffers.clear();
+
     delete graphicsCmdPool;
     delete computeCmdPool;
     delete transferCmdPool;
 
     delete graphicsQueue;
-    delete computeQueue;
-    delete transferQueue;
+    if (computeQueue != graphicsQueue) delete computeQueue;
+    if (transferQueue != graphicsQueue and transferQueue != computeQueue) delete transferQueue;
 
     vmaDestroyAllocator(allocator);
 
@@ -51,6 +117,10 @@ Device::~Device() {
 }
 
 void Device::createInstance() {
+    Vec<const char*> instanceExtensions;
+    if (!config.headless)
+        for (const char* ext : surfaceInstanceExtensions) instanceExtensions.push(ext);
+
     VkApplicationInfo appInfo{
         .sType      = VK_STRUCTURE_TYPE_APPLICATION_INFO,
         .apiVersion = VK_API_VERSION_1_3,
@@ -74,25 +144,56 @@ void Device::pickPhysicalDevice() {
     Vec<VkPhysicalDevice> devices(deviceCount);
     vkEnumeratePhysicalDevices(instance, &deviceCount, devices.getData());
 
-    for (auto pd : devices) {
-        getPhysicalDeviceFeatures(pd);
-
-        // clang-format off
-        bool featuresOk = supportedFeatures2.features.fillModeNonSolid and
-                          supportedVulkan13Features.synchronization2 and
-                          supportedVulkan13Features.dynamicRendering and
-                          supportedShaderObjectFeatures.shaderObject and
-                          supportedDescriptorBufferFeatures.descriptorBuffer and
-                          supportedLineRasterizationFeatures.rectangularLines and
-                          supportedLineRasterizationFeatures.bresenhamLines and
-                          supportedLineRasterizationFeatures.smoothLines;
-        // clang-format on
-
-        if (featuresOk)
-            physicalDevice = pd;
-        else
-            throw std::runtime_error("Failed to find suitable device");
+    const char* preferred = config.preferredDevice.getSize() ? config.preferredDevice.getData()
+                                                             : std::getenv("XV_DEVICE");
+
+    // A suitable device matching the override wins, otherwise (or if it isn't suitable) the best scored one
+    if (preferred and *preferred) {
+        for (u32 i = 0; i < deviceCount and !physicalDevice; i++)
+            if (matchesOverride(preferred, i, devices[i]) and isDeviceSuitable(devices[i]))
+                physicalDevice = devices[i];
     }
+
+    if (!physicalDevice) {
+        u64 bestScore = 0;
+        for (auto pd : devices) {
+            // Unsuitable devices are skipped instead of failing, another one may still be usable
+            if (!isDeviceSuitable(pd)) continue;
+
+            u64 score = scoreDevice(pd);
+            if (!physicalDevice or score > bestScore) physicalDevice = pd, bestScore = score;
+        }
+    }
+
+    if (!physicalDevice) throw std::runtime_error("Failed to find suitable device");
+
+    vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+    getPhysicalDeviceFeatures(physicalDevice);
+}
+
+bool Device::isDeviceSuitable(VkPhysicalDevice pd) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(pd, &properties);
+    if (properties.apiVersion < VK_API_VERSION_1_3) return false;
+
+    Vec<VkExtensionProperties> extensions = getDeviceExtensions(pd);
+    for (const char* ext : deviceExtensions)
+        if (!hasExtension(extensions, ext)) return false;
+    if (!config.headless and !hasExtension(extensions, swapchainExtension)) return false;
+
+    getPhysicalDeviceFeatures(pd);
+
+    // clang-format off
+    return supportedFeatures2.features.fillModeNonSolid and
+           supportedVulkan12Features.timelineSemaphore and
+           supportedVulkan13Features.synchronization2 and
+           supportedVulkan13Features.dynamicRendering and
+           supportedShaderObjectFeatures.shaderObject and
+           supportedDescriptorBufferFeatures.descriptorBuffer and
+           supportedLineRasterizationFeatures.rectangularLines and
+           supportedLineRasterizationFeatures.bresenhamLines and
+           supportedLineRasterizationFeatures.smoothLines;
+    // clang-format on
 }
 
 void Device::getPhysicalDeviceFeatures(VkPhysicalDevice pd) {
@@ -112,58 +213,93 @@ void Device::getPhysicalDeviceFeatures(VkPhysicalDevice pd) {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
         .pNext = &supportedShaderObjectFeatures,
     };
+    supportedVulkan12Features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .pNext = &supportedVulkan13Features,
+    };
     supportedFeatures2 = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
-        .pNext = &supportedVulkan13Features,
+        .pNext = &supportedVulkan12Features,
     };
 
     vkGetPhysicalDeviceFeatures2(pd, &supportedFeatures2);
 }
 
+void Device::setupOptionalExtensions() {
+    for (const char* ext : deviceExtensions) enabledExtensions.push(ext);
+    if (config.headless) return;
+
+    enabledExtensions.push(swapchainExtension);
+
+    // Present wait, used for frame pacing
+    Vec<VkExtensionProperties> extensions = getDeviceExtensions(physicalDevice);
+    if (hasExtension(extensions, presentIdExtension) and hasExtension(extensions, presentWaitExtension)) {
+        VkPhysicalDevicePresentIdFeaturesKHR presentId{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+        };
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWait{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+            .pNext = &presentId,
+        };
+        VkPhysicalDeviceFeatures2 features2{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &presentWait,
+        };
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+        presentWaitSupported = presentId.presentId and presentWait.presentWait;
+        if (presentWaitSupported) {
+            enabledExtensions.push(presentIdExtension);
+            enabledExtensions.push(presentWaitExtension);
+        }
+    }
+
+    // Present regions, lets the compositor only update what changed
+    incrementalPresentSupported = hasExtension(extensions, incrementalPresentExtension);
+    if (incrementalPresentSupported) enabledExtensions.push(incrementalPresentExtension);
+}
+
 void Device::setupQueueCreateInfos() {
     u32 queueFamilyCount;
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
     Vec<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.getData());
 
-    i32 qfIdx           = 0;
-    u32 prioritiesCount = 0;
-    for (const auto& qf : queueFamilies) {
-        bool isValid = false;
-        // We assume that any graphics queue also supports presenting
-        if (qf.queueFlags & VK_QUEUE_GRAPHICS_BIT and graphicsQueueFamily == -1) {
-            graphicsQueueFamily = qfIdx;
-            isValid             = true;
+    // Returns the first family that has all the required flags and none of the excluded ones
+    auto findFamily = [&](VkQueueFlags required, VkQueueFlags excluded) -> i32 {
+        for (u32 i = 0; i < queueFamilyCount; i++) {
+            VkQueueFlags flags = queueFamilies[i].queueFlags;
+            if ((flags & required) == required and !(flags & excluded)) return (i32)i;
         }
+        return -1;
+    };
 
-        if (qf.queueFlags & VK_QUEUE_COMPUTE_BIT and computeQueueFamily == -1) {
-            computeQueueFamily = qfIdx;
-            isValid            = true;
-        }
+    // We assume that any graphics queue also supports presenting
+    graphicsQueueFamily = findFamily(VK_QUEUE_GRAPHICS_BIT, 0);
 
-        if (qf.queueFlags & VK_QUEUE_TRANSFER_BIT and transferQueueFamily == -1) {
-            transferQueueFamily = qfIdx;
-            isValid             = true;
-        }
+    // Prefer dedicated families, their queues run concurrently with the graphics queue
+    computeQueueFamily = findFamily(VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+    if (computeQueueFamily == -1) computeQueueFamily = findFamily(VK_QUEUE_COMPUTE_BIT, 0);
 
-        if (isValid) {
-            VkDeviceQueueCreateInfo createInfo{
-                .sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-                .queueFamilyIndex = (u32)qfIdx,
-                .queueCount       = qf.queueCount,
-            };
-            prioritiesCount += qf.queueCount;
-            queueCreateInfos.push(createInfo);
-        }
+    transferQueueFamily = findFamily(VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+    if (transferQueueFamily == -1) transferQueueFamily = computeQueueFamily;
 
-        qfIdx++;
-    }
+    if (graphicsQueueFamily == -1 or computeQueueFamily == -1)
+        throw std::runtime_error("Failed to find required queue families");
+
+    // Only the first queue of each family is used
+    queuePriorities = Vec<f32>(1, 1.0f);
+    for (i32 family : {graphicsQueueFamily, computeQueueFamily, transferQueueFamily}) {
+        bool exists = false;
+        for (const auto& qInfo : queueCreateInfos) exists = exists or qInfo.queueFamilyIndex == (u32)family;
+        if (exists) continue;
 
-    queuePriorities = Vec<f32>(prioritiesCount, 1.0f);
-    u32 idx         = 0;
-    for (auto& qInfo : queueCreateInfos) {
-        qInfo.pQueuePriorities  = queuePriorities.getData() + idx;
-        idx                    += qInfo.queueCount;
+        queueCreateInfos.push({
+            .sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = (u32)family,
+            .queueCount       = 1,
+            .pQueuePriorities = queuePriorities.getData(),
+        });
     }
 }
 
@@ -173,16 +309,26 @@ void Device::createDevice() {
         .pNext                   = &enabledFeatures2,
         .queueCreateInfoCount    = (u32)queueCreateInfos.getSize(),
         .pQueueCreateInfos       = queueCreateInfos.getData(),
-        .enabledExtensionCount   = (u32)deviceExtensions.getSize(),
-        .ppEnabledExtensionNames = deviceExtensions.getData(),
+        .enabledExtensionCount   = (u32)enabledExtensions.getSize(),
+        .ppEnabledExtensionNames = enabledExtensions.getData(),
         .pEnabledFeatures        = nullptr,
     };
 
+    if (presentWaitSupported) createInfo.pNext = &enabledPresentWaitFeatures;
+
     vkCreateDevice(physicalDevice, &createInfo, nullptr, &device);
 
+    // Queues of the same family are the same VkQueue, which has to be shared to be synchronized correctly
     graphicsQueue = new Queue(this, graphicsQueueFamily);
-    computeQueue  = new Queue(this, computeQueueFamily);
-    transferQueue = new Queue(this, transferQueueFamily);
+    computeQueue  = hasAsyncCompute() ? new Queue(this, computeQueueFamily) : graphicsQueue;
+    if (transferQueueFamily == graphicsQueueFamily)
+        transferQueue = graphicsQueue;
+    else if (transferQueueFamily == computeQueueFamily)
+        transferQueue = computeQueue;
+    else
+        transferQueue = new Queue(this, transferQueueFamily);
+
+    if (config.submitThread) graphicsQueue->startSubmitThread();
 }
 
 void Device::createAllocator() {
@@ -215,10 +361,13 @@ void Device::getFunctionPointers() {
     GETCMD(vkGetShaderBinaryDataEXT);
 
     GETCMD(vkCmdBindDescriptorBuffersEXT);
+    GETCMD(vkCmdSetDescriptorBufferOffsetsEXT);
 
     GETCMD(vkGetDescriptorSetLayoutSizeEXT);
     GETCMD(vkGetDescriptorSetLayoutBindingOffsetEXT);
     GETCMD(vkGetDescriptorEXT);
+
+    if (presentWaitSupported) GETCMD(vkWaitForPresentKHR);
 }
 
 void Device::createCommandPools() {
@@ -256,4 +405,114 @@ void Device::createCommandPools() {
     }
 }
 
-void Device::waitIdle() { vkDeviceWaitIdle(device); }
+void Device::waitIdle() {
+    graphicsQueue->flushSubmissions();
+    vkDeviceWaitIdle(device);
+}
+
+BufferHandle Device::createBuffer(u64 size, VkBufferUsageFlags usage,
+                                  VmaAllocationCreateFlags allocationFlags) {
+    std::lock_guard lock(objectMutex);
+    return buffers.create(this, size, usage, allocationFlags);
+}
+
+ImageHandle Device::createImage(VkFormat format, u32 width, u32 height, VkImageUsageFlags usage,
+                                VkSampleCountFlagBits samples, VkImageLayout initialLayout,
+                                VmaAllocationCreateFlags allocationFlags) {
+    std::lock_guard lock(objectMutex);
+    return images.create(this, format, width, height, usage, samples, initialLayout, allocationFlags);
+}
+
+ImageHandle Device::createImage(VkImage image, VkFormat format) {
+    std::lock_guard lock(objectMutex);
+    return images.create(this, image, format);
+}
+
+ImageViewHandle Device::createImageView(ImageHandle image, VkImageAspectFlags aspect) {
+    std::lock_guard lock(objectMutex);
+    Image* img = images.get(image);
+    if (!img) throw std::runtime_error("Invalid image handle");
+    return imageViews.create(img, aspect);
+}
+
+ShaderHandle Device::createShader(const ShaderDesc& desc) {
+    std::lock_guard lock(objectMutex);
+    return shaders.create(this, desc);
+}
+
+SemaphoreHandle Device::createSemaphore(bool timeline, u64 value) {
+    std::lock_guard lock(objectMutex);
+    return semaphores.create(this, timeline, value);
+}
+
+void Device::destroy(BufferHandle handle) {
+    std::lock_guard lock(objectMutex);
+    if (!buffers.destroy(handle)) throw std::runtime_error("Invalid buffer handle");
+}
+
+void Device::destroy(ImageHandle handle) {
+    std::lock_guard lock(objectMutex);
+    if (!images.destroy(handle)) throw std::runtime_error("Invalid image handle");
+}
+
+void Device::destroy(ImageViewHandle handle) {
+    std::lock_guard lock(objectMutex);
+    if (!imageViews.destroy(handle)) throw std::runtime_error("Invalid image view handle");
+}
+
+void Device::destroy(ShaderHandle handle) {
+    std::lock_guard lock(objectMutex);
+    if (!shaders.destroy(handle)) throw std::runtime_error("Invalid shader handle");
+}
+
+void Device::destroy(SemaphoreHandle handle) {
+    std::lock_guard lock(objectMutex);
+    if (!semaphores.destroy(handle)) throw std::runtime_error("Invalid semaphore handle");
+}
+
+void Device::destroyDeferred(BufferHandle handle) {
+    destroyDeferred([this, handle]() { destroy(handle); });
+}
+
+void Device::destroyDeferred(ImageHandle handle) {
+    destroyDeferred([this, handle]() { destroy(handle); });
+}
+
+void Device::destroyDeferred(ImageViewHandle handle) {
+    destroyDeferred([this, handle]() { destroy(handle); });
+}
+
+void Device::destroyDeferred(ShaderHandle handle) {
+    destroyDeferred([this, handle]() { destroy(handle); });
+}
+
+void Device::destroyDeferred(SemaphoreHandle handle) {
+    destroyDeferred([this, handle]() { destroy(handle); });
+}
+
+void Device::destroyDeferred(const std::function<void()>& destroy) {
+    std::lock_guard lock(objectMutex);
+    deletionQueue.push(getSubmittedSyncPoint(), destroy);
+}
+
+void Device::processDeletionQueue() {
+    std::lock_guard lock(objectMutex);
+    if (deletionQueue.getSize() == 0) return;
+    deletionQueue.collect(getCompletedSyncPoint());
+}
+
+SyncPoint Device::getSubmittedSyncPoint() const {
+    return {
+        .graphics = graphicsQueue->getSubmittedValue(),
+        .compute  = computeQueue->getSubmittedValue(),
+        .transfer = transferQueue->getSubmittedValue(),
+    };
+}
+
+SyncPoint Device::getCompletedSyncPoint() {
+    return {
+        .graphics = graphicsQueue->getCompletedValue(),
+        .compute  = computeQueue->getCompletedValue(),
+        .transfer = transferQueue->getCompletedValue(),
+    };
+}
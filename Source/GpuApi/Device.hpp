@@ -1,9 +1,16 @@
 #pragma once
 
+#include <mutex>
 #include <vulkan/vulkan.h>
 
+#include "Buffer.hpp"
 #include "Common.hpp"
 #include "Core/Core.hpp"
+#include "Core/SlotMap.hpp"
+#include "DeletionQueue.hpp"
+#include "Image.hpp"
+#include "Semaphore.hpp"
+#include "Shader.hpp"
 #include "ThirdParty/vma/vk_mem_alloc.h"
 
 #define DEFCMD(x) \
@@ -16,14 +23,18 @@ class Device {
    private:
     VkInstance instance{};
     VkPhysicalDevice physicalDevice{};
+    VkPhysicalDeviceProperties physicalDeviceProperties{};
     VkDevice device{};
 
+    DeviceConfig config;
+
     VmaAllocator allocator{};
 
     VkPhysicalDeviceLineRasterizationFeaturesEXT supportedLineRasterizationFeatures{};
     VkPhysicalDeviceDescriptorBufferFeaturesEXT supportedDescriptorBufferFeatures{};
     VkPhysicalDeviceShaderObjectFeaturesEXT supportedShaderObjectFeatures{};
     VkPhysicalDeviceVulkan13Features supportedVulkan13Features{};
+    VkPhysicalDeviceVulkan12Features supportedVulkan12Features{};
     VkPhysicalDeviceFeatures2 supportedFeatures2{};
 
     VkPhysicalDeviceLineRasterizationFeaturesEXT enabledLineRasterizationFeatures{
@@ -49,15 +60,36 @@ class Device {
         .synchronization2 = true,
         .dynamicRendering = true,
     };
+    VkPhysicalDeviceVulkan12Features enabledVulkan12Features{
+        .sType             = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .pNext             = &enabledVulkan13Features,
+        .timelineSemaphore = true,
+    };
     VkPhysicalDeviceFeatures2 enabledFeatures2{
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
-        .pNext = &enabledVulkan13Features,
+        .pNext = &enabledVulkan12Features,
         .features =
             {
                 .fillModeNonSolid = true,
             },
     };
 
+    // Optional features, only chained into device creation when supported
+    VkPhysicalDevicePresentIdFeaturesKHR enabledPresentIdFeatures{
+        .sType     = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+        .pNext     = &enabledFeatures2,
+        .presentId = true,
+    };
+    VkPhysicalDevicePresentWaitFeaturesKHR enabledPresentWaitFeatures{
+        .sType       = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+        .pNext       = &enabledPresentIdFeatures,
+        .presentWait = true,
+    };
+
+    Vec<const char*> enabledExtensions;
+    bool presentWaitSupported        = false;
+    bool incrementalPresentSupported = false;
+
     i32 graphicsQueueFamily = -1;
     i32 computeQueueFamily  = -1;
     i32 transferQueueFamily = -1;
@@ -73,6 +105,17 @@ class Device {
     CmdPool* computeCmdPool{};
     CmdPool* transferCmdPool{};
 
+    SlotMap<Buffer> buffers;
+    SlotMap<Image> images;
+    SlotMap<ImageView> imageViews;
+    SlotMap<Shader> shaders;
+    SlotMap<Semaphore> semaphores;
+
+    DeletionQueue deletionQueue;
+
+    // Guards the object pools and the deletion queue, recursive since deferred destructions call destroy()
+    std::recursive_mutex objectMutex;
+
    public:
     DEFCMD(vkCmdSetVertexInputEXT);
     DEFCMD(vkCmdSetRasterizationSamplesEXT);
@@ -92,16 +135,79 @@ class Device {
     DEFCMD(vkGetShaderBinaryDataEXT);
 
     DEFCMD(vkCmdBindDescriptorBuffersEXT);
+    DEFCMD(vkCmdSetDescriptorBufferOffsetsEXT);
 
     DEFCMD(vkGetDescriptorSetLayoutSizeEXT);
     DEFCMD(vkGetDescriptorSetLayoutBindingOffsetEXT);
     DEFCMD(vkGetDescriptorEXT);
 
-    Device();
+    DEFCMD(vkWaitForPresentKHR);
+
+    explicit Device(const DeviceConfig& config = {});
     ~Device();
 
     void waitIdle();
 
+    // Object pools
+    BufferHandle createBuffer(u64 size, VkBufferUsageFlags usage,
+                              VmaAllocationCreateFlags allocationFlags = 0);
+    ImageHandle createImage(VkFormat format, u32 width, u32 height, VkImageUsageFlags usage,
+                            VkSampleCountFlagBits samples,
+                            VkImageLayout initialLayout              = VK_IMAGE_LAYOUT_UNDEFINED,
+                            VmaAllocationCreateFlags allocationFlags = 0);
+    ImageHandle createImage(VkImage image, VkFormat format);
+    ImageViewHandle createImageView(ImageHandle image, VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+    ShaderHandle createShader(const ShaderDesc& desc);
+    SemaphoreHandle createSemaphore(bool timeline = false, u64 value = 0);
+
+    void destroy(BufferHandle handle);
+    void destroy(ImageHandle handle);
+    void destroy(ImageViewHandle handle);
+    void destroy(ShaderHandle handle);
+    void destroy(SemaphoreHandle handle);
+
+    // Returned pointers are only valid until the next create or destroy call on the same pool. Creating and
+    // destroying objects is thread safe, but when other threads may do so pointers have to be used while
+    // holding lockObjects()
+    inline Buffer* get(BufferHandle handle) { return buffers.get(handle); }
+    inline Image* get(ImageHandle handle) { return images.get(handle); }
+    inline ImageView* get(ImageViewHandle handle) { return imageViews.get(handle); }
+    inline Shader* get(ShaderHandle handle) { return shaders.get(handle); }
+    inline Semaphore* get(SemaphoreHandle handle) { return semaphores.get(handle); }
+
+    // Deferred destruction, objects are destroyed once every submission made so far on any queue has
+    // completed on the GPU. Command buffers using the object must have been submitted before this call
+    void destroyDeferred(BufferHandle handle);
+    void destroyDeferred(ImageHandle handle);
+    void destroyDeferred(ImageViewHandle handle);
+    void destroyDeferred(ShaderHandle handle);
+    void destroyDeferred(SemaphoreHandle handle);
+    void destroyDeferred(const std::function<void()>& destroy);
+
+    /// Runs the deferred destructions whose submissions have completed, never blocks
+    void processDeletionQueue();
+
+    /// Keeps other threads from creating or destroying objects while the lock is held
+    [[nodiscard]] inline std::unique_lock<std::recursive_mutex> lockObjects() {
+        return std::unique_lock(objectMutex);
+    }
+
+    [[nodiscard]] inline bool isHeadless() const { return config.headless; }
+
+    /// VK_KHR_present_id and VK_KHR_present_wait are both enabled
+    [[nodiscard]] inline bool supportsPresentWait() const { return presentWaitSupported; }
+
+    /// VK_KHR_incremental_present is enabled, see Queue::present
+    [[nodiscard]] inline bool supportsIncrementalPresent() const { return incrementalPresentSupported; }
+
+    /// Timeline values of the last submission on each queue
+    [[nodiscard]] SyncPoint getSubmittedSyncPoint() const;
+    /// Timeline values of the last submission completed by the GPU on each queue, never blocks
+    SyncPoint getCompletedSyncPoint();
+
+    /// The compute queue is on a different family than the graphics queue and can run work concurrently
+    [[nodiscard]] inline bool hasAsyncCompute() const { return computeQueueFamily != graphicsQueueFamily; }
+
     inline Queue* getGraphicsQueue() { return graphicsQueue; }
     inline Queue* getComputeQueue() { return computeQueue; }
     inline Queue* getTransferQueue() { return transferQueue; }
@@ -113,12 +219,17 @@ class Device {
     inline VkDevice getVkDevice() { return device; }
     inline VkInstance getVkInstance() { return instance; }
     inline VkPhysicalDevice getVkPhysicalDevice() { return physicalDevice; }
+    [[nodiscard]] inline const VkPhysicalDeviceProperties& getPhysicalDeviceProperties() const {
+        return physicalDeviceProperties;
+    }
     inline VmaAllocator getVmaAllocator() { return allocator; }
 
    private:
     void createInstance();
     void pickPhysicalDevice();
+    bool isDeviceSuitable(VkPhysicalDevice pd);
     void getPhysicalDeviceFeatures(VkPhysicalDevice pd);
+    void setupOptionalExtensions();
     void setupQueueCreateInfos();
     void createDevice();
     void createAllocator();
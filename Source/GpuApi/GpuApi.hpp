@@ -5,10 +5,13 @@
 #include "ThirdParty/vma/vk_mem_alloc.h"
 
 #include "Common.hpp"
+#include "BarrierBatch.hpp"
+#include "DeletionQueue.hpp"
 #include "Device.hpp"
 #include "Fence.hpp"
 #include "Semaphore.hpp"
 #include "Queue.hpp"
+#include "SubmitThread.hpp"
 #include "Surface.hpp"
 #include "CmdBuffer.hpp"
 #include "Shader.hpp"
@@ -3,44 +3,134 @@
 #include "CmdBuffer.hpp"
 #include "Fence.hpp"
 #include "Semaphore.hpp"
+#include "SubmitThread.hpp"
 #include "Surface.hpp"
 
+static void checkSubmitResult(VkResult result) {
+    if (result != VK_SUCCESS)
+        throw std::runtime_error(std::format("Failed to submit to the queue (VkResult {})", (i32)result));
+}
+
 Queue::Queue(Device *_device, u32 _familyIndex) : device(_device), familyIndex(_familyIndex) {
     vkGetDeviceQueue(device->getVkDevice(), familyIndex, 0, &queue);
+    timeline = new Semaphore(device, true, 0);
 }
 
-void Queue::submit(const Vec<CmdBuffer *> &_cmdBuffers, const Vec<Semaphore *> &_waitSemaphores,
-                   const Vec<Semaphore *> &_signalSemaphores, const Vec<VkPipelineStageFlags> &waitStageMask,
-                   Fence *fence) {
-    Vec<VkCommandBuffer> cmdBuffers;
-    Vec<VkSemaphore> waitSemaphores;
-    Vec<VkSemaphore> signalSemaphores;
-
-    for (CmdBuffer *c : _cmdBuffers) cmdBuffers.push(c ? c->getVkCommandBuffer() : nullptr);
-    for (Semaphore *s : _waitSemaphores) waitSemaphores.push(s ? s->getVkSemaphore() : nullptr);
-    for (Semaphore *s : _signalSemaphores) signalSemaphores.push(s ? s->getVkSemaphore() : nullptr);
-
-    VkSubmitInfo submitInfo{
-        .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .waitSemaphoreCount   = (u32)waitSemaphores.getSize(),
-        .pWaitSemaphores      = waitSemaphores.getData(),
-        .pWaitDstStageMask    = waitStageMask.getData(),
-        .commandBufferCount   = (u32)cmdBuffers.getSize(),
-        .pCommandBuffers      = cmdBuffers.getData(),
-        .signalSemaphoreCount = (u32)signalSemaphores.getSize(),
-        .pSignalSemaphores    = signalSemaphores.getData(),
+Queue::~Queue() {
+    delete submitThread;
+    delete timeline;
+}
+
+u64 Queue::submit(const SubmitInfo &info) {
+    std::lock_guard lock(submitMutex);
+
+    // The value is taken under the lock so the timeline is signaled in submission order. Without a submit
+    // thread it's only published once submitted, with one it's published right away
+    u64 value = submittedValue + 1;
+    if (submitThread) {
+        checkSubmitResult(submitThread->takeError());
+        submittedValue = value;
+        submitThread->push({.submitInfo = info, .timelineValue = value});
+    } else {
+        checkSubmitResult(submitNow(info, value));
+        submittedValue = value;
+    }
+    return value;
+}
+
+VkResult Queue::submitNow(const SubmitInfo &info, u64 timelineValue) {
+    Vec<VkCommandBufferSubmitInfo> cmdBuffers;
+    Vec<VkSemaphoreSubmitInfo> waitSemaphores;
+    Vec<VkSemaphoreSubmitInfo> signalSemaphores;
+
+    for (CmdBuffer *c : info.cmdBuffers) {
+        cmdBuffers.push({
+            .sType         = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+            .commandBuffer = c->getVkCommandBuffer(),
+        });
+    }
+    for (const auto &s : info.waitSemaphores) {
+        waitSemaphores.push({
+            .sType     = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = s.semaphore->getVkSemaphore(),
+            .value     = s.value,
+            .stageMask = s.stageMask,
+        });
+    }
+    for (const auto &s : info.signalSemaphores) {
+        signalSemaphores.push({
+            .sType     = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = s.semaphore->getVkSemaphore(),
+            .value     = s.value,
+            .stageMask = s.stageMask,
+        });
+    }
+
+    // Every submission signals the queue timeline, used for deferred destruction and cross queue waits
+    signalSemaphores.push({
+        .sType     = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = timeline->getVkSemaphore(),
+        .value     = timelineValue,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+    });
+
+    VkSubmitInfo2 submitInfo{
+        .sType                    = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .waitSemaphoreInfoCount   = (u32)waitSemaphores.getSize(),
+        .pWaitSemaphoreInfos      = waitSemaphores.getData(),
+        .commandBufferInfoCount   = (u32)cmdBuffers.getSize(),
+        .pCommandBufferInfos      = cmdBuffers.getData(),
+        .signalSemaphoreInfoCount = (u32)signalSemaphores.getSize(),
+        .pSignalSemaphoreInfos    = signalSemaphores.getData(),
     };
 
     VkFence f = nullptr;
-    if (fence) f = fence->getVkFence();
-    vkQueueSubmit(queue, 1, &submitInfo, f);
+    if (info.fence) f = info.fence->getVkFence();
+    std::lock_guard lock(queueMutex);
+    return vkQueueSubmit2(queue, 1, &submitInfo, f);
+}
+
+u64 Queue::submit(const Vec<CmdBuffer *> &cmdBuffers, const Vec<Semaphore *> &waitSemaphores,
+                  const Vec<Semaphore *> &signalSemaphores, const Vec<VkPipelineStageFlags> &waitStageMask,
+                  Fence *fence) {
+    SubmitInfo info{
+        .cmdBuffers = cmdBuffers,
+        .fence      = fence,
+    };
+    for (u64 i = 0; i < waitSemaphores.getSize(); i++) {
+        VkPipelineStageFlags2 stageMask =
+            i < waitStageMask.getSize() ? waitStageMask[i] : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        info.waitSemaphores.push({waitSemaphores[i], 0, stageMask});
+    }
+    for (Semaphore *s : signalSemaphores)
+        info.signalSemaphores.push({s, 0, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT});
+
+    return submit(info);
 }
 
-VkResult Queue::present(const Vec<Semaphore *> &_waitSemaphores, Surface *surface, u32 imageIndex) {
+VkResult Queue::present(const Vec<Semaphore *> &waitSemaphores, Surface *surface, u32 imageIndex,
+                        u64 presentId, const Vec<VkRectLayerKHR> &regions) {
+    std::lock_guard lock(submitMutex);
+    if (!submitThread)
+        return presentNow(waitSemaphores, surface->getVkSwapchain(), imageIndex, presentId, regions);
+
+    if (VkResult error = submitThread->takeError(); error != VK_SUCCESS) return error;
+    submitThread->push({
+        .present        = true,
+        .waitSemaphores = waitSemaphores,
+        .swapchain      = surface->getVkSwapchain(),
+        .imageIndex     = imageIndex,
+        .presentId      = presentId,
+        .regions        = regions,
+    });
+    return VK_SUCCESS;
+}
+
+VkResult Queue::presentNow(const Vec<Semaphore *> &_waitSemaphores, VkSwapchainKHR swapchain, u32 imageIndex,
+                           u64 presentId, const Vec<VkRectLayerKHR> &regions) {
     Vec<VkSemaphore> waitSemaphores;
     for (Semaphore *s : _waitSemaphores) waitSemaphores.push(s->getVkSemaphore());
 
-    VkSwapchainKHR swapchain = surface->getVkSwapchain();
     VkResult result;
     VkPresentInfoKHR presentInfo{
         .sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -52,8 +142,47 @@ VkResult Queue::present(const Vec<Semaphore *> &_waitSemaphores, Surface *surfac
         .pResults           = &result,
     };
 
-    vkQueuePresentKHR(queue, &presentInfo);
-    return result;
+    VkPresentIdKHR presentIdInfo{
+        .sType          = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+        .swapchainCount = 1,
+        .pPresentIds    = &presentId,
+    };
+    if (presentId and device->supportsPresentWait()) presentInfo.pNext = &presentIdInfo;
+
+    // An empty region list would mean the whole image changed, which is also what leaving it out means
+    VkPresentRegionKHR region{
+        .rectangleCount = (u32)regions.getSize(),
+        .pRectangles    = regions.getData(),
+    };
+    VkPresentRegionsKHR presentRegions{
+        .sType          = VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR,
+        .pNext          = presentInfo.pNext,
+        .swapchainCount = 1,
+        .pRegions       = &region,
+    };
+    if (regions.getSize() > 0 and device->supportsIncrementalPresent()) presentInfo.pNext = &presentRegions;
+
+    std::unique_lock lock(queueMutex);
+    VkResult presentResult = vkQueuePresentKHR(queue, &presentInfo);
+    lock.unlock();
+    return presentResult != VK_SUCCESS ? presentResult : result;
+}
+
+void Queue::startSubmitThread() {
+    std::lock_guard lock(submitMutex);
+    if (!submitThread) submitThread = new SubmitThread(this);
+}
+
+VkResult Queue::flushSubmissions() {
+    if (!submitThread) return VK_SUCCESS;
+    submitThread->flush();
+    return submitThread->takeError();
+}
+
+void Queue::waitIdle() {
+    flushSubmissions();
+    std::lock_guard lock(queueMutex);
+    vkQueueWaitIdle(queue);
 }
 
-void Queue::waitIdle() { vkQueueWaitIdle(queue); }
\ No newline at end of file
+u64 Queue::getCompletedValue() { return timeline->getValue(); }
\ No newline at end of file
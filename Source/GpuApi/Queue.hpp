@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
 #include <vulkan/vulkan.h>
 
 #include "Core/Core.hpp"
@@ -9,27 +11,96 @@ class CmdBuffer;
 class Semaphore;
 class Fence;
 class Surface;
+class SubmitThread;
 
 class Queue {
     friend Device;
+    friend SubmitThread;
 
    private:
     Device* device;
     VkQueue queue{};
     u32 familyIndex;
 
+    // Signaled by every submission on this queue with an increasing value
+    Semaphore* timeline{};
+    std::atomic<u64> submittedValue = 0;
+
+    // Hands out timeline values in submission order
+    std::mutex submitMutex;
+    // VkQueue is externally synchronized, windows rendering on their own threads share the queues
+    std::mutex queueMutex;
+
+    SubmitThread* submitThread{};
+
     Queue(Device* device, u32 familyIndex);
+    ~Queue();
 
    public:
-    void submit(const Vec<CmdBuffer*>& cmdBuffers, const Vec<Semaphore*>& waitSemaphores = {},
-                const Vec<Semaphore*>& signalSemaphores        = {},
-                const Vec<VkPipelineStageFlags>& waitStageMask = {}, Fence* fence = nullptr);
+    /**
+     * @brief Submits command buffers with vkQueueSubmit2, can be called from any thread.
+     *
+     * Other queues can wait on the returned value of getTimeline(), which is how async compute work is
+     * ordered against graphics work.
+     *
+     * Throws if the submission fails, with a submit thread also if an earlier one failed on it.
+     *
+     * @return The value the queue timeline reaches once the submission completes.
+     */
+    u64 submit(const SubmitInfo& info);
+
+    u64 submit(const Vec<CmdBuffer*>& cmdBuffers, const Vec<Semaphore*>& waitSemaphores = {},
+               const Vec<Semaphore*>& signalSemaphores        = {},
+               const Vec<VkPipelineStageFlags>& waitStageMask = {}, Fence* fence = nullptr);
+
+    /**
+     * @brief Presents a swapchain image.
+     *
+     * With a submit thread the present is only queued and VK_SUCCESS is returned. An out of date or
+     * suboptimal swapchain is then reported by the next image acquisition instead, other errors of earlier
+     * submissions and presents are returned without queueing this one.
+     *
+     * @param presentId Can be waited on with Surface::waitForPresent if the device supports present wait.
+     * @param regions What changed since the previous present, passed on with VK_KHR_incremental_present if
+     * the device supports it. Empty means the whole image changed.
+     */
+    VkResult present(const Vec<Semaphore*>& waitSemaphores, Surface* surface, u32 imageIndex,
+                     u64 presentId = 0, const Vec<VkRectLayerKHR>& regions = {});
 
-    VkResult present(const Vec<Semaphore*>& waitSemaphores, Surface* surface, u32 imageIndex);
+    /**
+     * @brief Moves the vkQueueSubmit2 and vkQueuePresentKHR calls to a dedicated thread.
+     *
+     * Submitting then only costs a copy of the submit info, the driver overhead and any blocking in present
+     * no longer delay the calling thread. Timeline values are still returned right away, waiting on them
+     * before the submission is handed to the driver is valid for timeline semaphores.
+     */
+    void startSubmitThread();
+
+    /**
+     * @brief Blocks until the submit thread has handed every queued submission and present to the driver.
+     *
+     * Swapchains are externally synchronized, so this has to be called before acquiring from, waiting on or
+     * recreating a swapchain that was presented through the submit thread. Does nothing without one.
+     *
+     * @return The first error of a submission or present made by the submit thread since it was last
+     * reported, e.g. VK_ERROR_DEVICE_LOST or VK_ERROR_SURFACE_LOST_KHR.
+     */
+    VkResult flushSubmissions();
 
     void waitIdle();
 
+    /// Timeline value of the last submission completed by the GPU, never blocks
+    u64 getCompletedValue();
+
     inline Device* getDevice() { return device; }
     inline VkQueue getVkQueue() { return queue; }
+    inline Semaphore* getTimeline() { return timeline; }
+    [[nodiscard]] inline u64 getSubmittedValue() const { return submittedValue; }
     [[nodiscard]] inline u32 getFamilyIndex() const { return familyIndex; }
+    [[nodiscard]] inline bool hasSubmitThread() const { return submitThread != nullptr; }
+
+   private:
+    VkResult submitNow(const SubmitInfo& info, u64 timelineValue);
+    VkResult presentNow(const Vec<Semaphore*>& waitSemaphores, VkSwapchainKHR swapchain, u32 imageIndex,
+                        u64 presentId, const Vec<VkRectLayerKHR>& regions);
 };
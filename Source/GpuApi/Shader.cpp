@@ -28,8 +28,8 @@ Shader::Shader(Device *_device, const ShaderDesc &desc) : device(_device) {
         .stage                  = desc.stage,
         .nextStage              = desc.nextStage,
         .codeType               = desc.codeType,
-        .codeSize               = desc.code.getSize(),
-        .pCode                  = desc.code.getData(),
+        .codeSize               = desc.codeSize,
+        .pCode                  = desc.code,
         .pName                  = desc.name,
         .setLayoutCount         = (u32)sets.getSize(),
         .pSetLayouts            = sets.getData(),
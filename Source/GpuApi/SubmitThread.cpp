@@ -0,0 +1,46 @@
+#include "SubmitThread.hpp"
+
+#include "Queue.hpp"
+
+SubmitThread::SubmitThread(Queue *_queue) : queue(_queue) {
+    thread = std::thread([this]() { run(); });
+}
+
+SubmitThread::~SubmitThread() {
+    requests.push({.stop = true});
+    thread.join();
+}
+
+void SubmitThread::push(Request &&request) {
+    requests.push(std::move(request));
+    pushed++;
+}
+
+void SubmitThread::flush() {
+    u64 target = pushed.load();
+    for (u64 done = processed.load(); done < target; done = processed.load()) processed.wait(done);
+}
+
+VkResult SubmitThread::takeError() { return error.exchange(VK_SUCCESS); }
+
+void SubmitThread::run() {
+    Request request;
+    while (true) {
+        requests.pop(request);
+        if (request.stop) return;
+
+        VkResult result;
+        if (request.present) {
+            result = queue->presentNow(request.waitSemaphores, request.swapchain, request.imageIndex,
+                                       request.presentId, request.regions);
+            if (result == VK_SUBOPTIMAL_KHR or result == VK_ERROR_OUT_OF_DATE_KHR) result = VK_SUCCESS;
+        } else
+            result = queue->submitNow(request.submitInfo, request.timelineValue);
+
+        VkResult none = VK_SUCCESS;
+        if (result != VK_SUCCESS) error.compare_exchange_strong(none, result);
+
+        processed++;
+        processed.notify_all();
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vulkan/vulkan.h>
+
+#include "Common.hpp"
+#include "Core/Core.hpp"
+#include "Core/SpscQueue.hpp"
+
+class Queue;
+
+/**
+ * @brief Thread that makes the vkQueueSubmit2 and vkQueuePresentKHR calls of a queue.
+ *
+ * Requests are passed through a lock-free SPSC queue. The queue serializes its producers with its submit
+ * mutex, so the submit thread is the only consumer and sees the requests in the order the timeline values
+ * were handed out. The thread sleeps on the queue while it's empty.
+ *
+ * The first failed submission or present is kept until the queue takes it, to be reported by the next call
+ * on the queue. Out of date and suboptimal swapchains aren't errors here, the next acquire reports them.
+ */
+class SubmitThread {
+    friend Queue;
+
+   private:
+    struct Request {
+        bool stop    = false;
+        bool present = false;
+        // Submission
+        SubmitInfo submitInfo{};
+        u64 timelineValue = 0;
+        // Present, the swapchain is captured when the request is made since the surface may recreate it
+        Vec<Semaphore*> waitSemaphores;
+        VkSwapchainKHR swapchain{};
+        u32 imageIndex = 0;
+        u64 presentId  = 0;
+        Vec<VkRectLayerKHR> regions;
+    };
+
+    static constexpr u64 CAPACITY = 16;
+
+    Queue* queue;
+    SpscQueue<Request, CAPACITY> requests;
+
+    std::atomic<u64> pushed     = 0;
+    std::atomic<u64> processed  = 0;
+    std::atomic<VkResult> error = VK_SUCCESS;
+    std::thread thread;
+
+    explicit SubmitThread(Queue* queue);
+    ~SubmitThread();
+
+    /// Blocks while the queue is full, calls must be serialized
+    void push(Request&& request);
+
+    /// Blocks until every request pushed so far has been handed to the driver
+    void flush();
+
+    /// Returns the first error since the last call, VK_SUCCESS if there was none
+    VkResult takeError();
+
+    void run();
+};
@@ -3,6 +3,7 @@
 #include <vulkan/vulkan.h>
 
 #include "App/Window/Window.hpp"
+#include "Core/Math.hpp"
 #include "Device.hpp"
 #include "Image.hpp"
 
@@ -20,18 +21,22 @@
 #include "Semaphore.hpp"
 
 Surface::Surface(Device* _device, Window* _window) : device(_device), window(_window) {
+    if (device->isHeadless()) throw std::runtime_error("Can't create a surface on a headless device");
     createSurface();
     getSurfaceSupport();
 }
 
 Surface::~Surface() {
     destroySwapchain();
-    vkDestroySurfaceKHR(device->getVkInstance(), surface, nullptr);
-}
 
-void Surface::configure(const SurfaceConfig& config) {
-    getSurfaceSupport();
+    // Queued after the swapchain so it is destroyed first
+    VkInstance instance = device->getVkInstance();
+    VkSurfaceKHR s      = surface;
+    device->destroyDeferred([instance, s]() { vkDestroySurfaceKHR(instance, s, nullptr); });
+}
 
+// Supported formats and present modes don't change for a surface, they are only queried on creation
+bool Surface::configure(const SurfaceConfig& config) {
     // Format and color space
     bool formatOk = false;
     for (const auto& f : supportedFormats) {
@@ -55,24 +60,32 @@ void Surface::configure(const SurfaceConfig& config) {
     }
     if (!presentModeOk) throw std::runtime_error("Present mode not supported");
 
+    return resize(config.width, config.height);
+}
+
+bool Surface::resize(u32 width, u32 height) {
+    updateSurfaceCapabilities();
+
     // Extent
-    if (isX11Window) {
+    if (surfaceCaps.currentExtent.width != UINT32_MAX) {  // The window system dictates the size (X11)
         extent = surfaceCaps.currentExtent;
-    } else if (config.width >= surfaceCaps.minImageExtent.width and
-               config.width <= surfaceCaps.maxImageExtent.width and
-               config.height >= surfaceCaps.minImageExtent.height and
-               config.height <= surfaceCaps.maxImageExtent.height) {
-        extent = {config.width, config.height};
-    } else
-        throw std::runtime_error("Extent not supported");
+    } else {  // Sizes sent mid-resize can be slightly out of range, clamp them instead of failing
+        extent = {
+            math::clamp(width, surfaceCaps.minImageExtent.width, surfaceCaps.maxImageExtent.width),
+            math::clamp(height, surfaceCaps.minImageExtent.height, surfaceCaps.maxImageExtent.height),
+        };
+    }
+
+    // Minimized window, keep the current swapchain until there is something to present again
+    if (extent.width == 0 or extent.height == 0) return false;
 
     createSwapchain();
+    return true;
 }
 
 void Surface::createSurface() {
 #ifdef __linux__
     if (auto x11Window = dynamic_cast<X11Window*>(window)) {
-        isX11Window = true;
         VkXcbSurfaceCreateInfoKHR createInfo{
             .sType      = VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR,
             .connection = x11Window->getXcbConnection(),
@@ -107,7 +120,10 @@ void Surface::getSurfaceSupport() {
     vkGetPhysicalDeviceSurfacePresentModesKHR(
         device->getVkPhysicalDevice(), surface, &presentModeCount, supportedPresentModes.getData());
 
-    // Get surface capabilities
+    updateSurfaceCapabilities();
+}
+
+void Surface::updateSurfaceCapabilities() {
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device->getVkPhysicalDevice(), surface, &surfaceCaps);
 }
 
@@ -145,22 +161,28 @@ void Surface::createSwapchain() {
     vkGetSwapchainImagesKHR(device->getVkDevice(), swapchain, &imageCount, vkImages.getData());
 
     for (VkImage img : vkImages) {
-        images.push(new Image(device, img, format));
+        images.push(device->createImage(img, format));
     }
 
     // Create image views
-    for (Image* img : images) {
-        imageViews.push(new ImageView(img));
+    for (ImageHandle img : images) {
+        imageViews.push(device->createImageView(img));
     }
 }
 
+// The swapchain may still be in use by frames in flight, so destruction is deferred until the GPU is done
 void Surface::destroySwapchain() {
     if (swapchain) {
-        vkDestroySwapchainKHR(device->getVkDevice(), swapchain, nullptr);
-        for (auto view : imageViews) delete view;
-        for (auto img : images) delete img;
+        for (auto view : imageViews) device->destroyDeferred(view);
+        for (auto img : images) device->destroyDeferred(img);
+
+        VkDevice vkDevice  = device->getVkDevice();
+        VkSwapchainKHR old  = swapchain;
+        device->destroyDeferred([vkDevice, old]() { vkDestroySwapchainKHR(vkDevice, old, nullptr); });
+
         images.clear();
         imageViews.clear();
+        swapchain = VK_NULL_HANDLE;
     }
 }
 
@@ -169,3 +191,30 @@ VkResult Surface::getNextImageIndex(u64 timeout, Semaphore* semaphore, Fence* fe
     VkFence vkFence         = fence ? fence->getVkFence() : nullptr;
     return vkAcquireNextImageKHR(device->getVkDevice(), swapchain, timeout, vkSemaphore, vkFence, &idx);
 }
+
+VkPresentModeKHR Surface::choosePresentMode(VkPresentModeKHR preferred) const {
+    // Fallbacks never introduce tearing unless the preferred mode already tears
+    Vec<VkPresentModeKHR> candidates;
+    switch (preferred) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+            candidates = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+                          VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+            break;
+        case VK_PRESENT_MODE_MAILBOX_KHR: candidates = {VK_PRESENT_MODE_MAILBOX_KHR}; break;
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: candidates = {VK_PRESENT_MODE_FIFO_RELAXED_KHR}; break;
+        default: break;
+    }
+
+    for (auto c : candidates) {
+        for (auto pm : supportedPresentModes)
+            if (pm == c) return c;
+    }
+
+    // Always supported
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+VkResult Surface::waitForPresent(u64 presentId, u64 timeout) {
+    if (!device->supportsPresentWait()) return VK_ERROR_FEATURE_NOT_PRESENT;
+    return device->vkWaitForPresentKHR(device->getVkDevice(), swapchain, presentId, timeout);
+}
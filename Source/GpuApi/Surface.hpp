@@ -28,22 +28,30 @@ class Surface {
     VkSurfaceCapabilitiesKHR surfaceCaps{};
 
     u32 imageCount = 0;
-    Vec<Image*> images;
-    Vec<ImageView*> imageViews;
-
-    bool isX11Window = false;
+    Vec<ImageHandle> images;
+    Vec<ImageViewHandle> imageViews;
 
    public:
     Surface(Device* device, Window* window);
 
     ~Surface();
 
-    void configure(const SurfaceConfig& config);
+    /// Returns false if the surface has no area (minimized), the swapchain is created once it has
+    bool configure(const SurfaceConfig& config);
+
+    /// Recreates the swapchain with a new size, returns false if the surface has no area (minimized)
+    bool resize(u32 width, u32 height);
 
     VkResult getNextImageIndex(u64 timeout, Semaphore* semaphore, Fence* fence, u32& idx);
 
-    inline const Vec<Image*>& getImages() { return images; }
-    inline const Vec<ImageView*>& getImageViews() { return imageViews; }
+    /// Returns the preferred present mode if supported, otherwise the closest supported one
+    [[nodiscard]] VkPresentModeKHR choosePresentMode(VkPresentModeKHR preferred) const;
+
+    /// Waits until the present with the given id is displayed, requires Device::supportsPresentWait
+    VkResult waitForPresent(u64 presentId, u64 timeout);
+
+    inline const Vec<ImageHandle>& getImages() { return images; }
+    inline const Vec<ImageViewHandle>& getImageViews() { return imageViews; }
 
     inline Device* getDevice() { return device; }
     inline Window* getWindow() { return window; }
@@ -53,6 +61,7 @@ class Surface {
     [[nodiscard]] inline VkFormat getFormat() const { return format; }
     [[nodiscard]] inline VkColorSpaceKHR getColorSpace() const { return colorSpace; }
     [[nodiscard]] inline VkPresentModeKHR getPresentMode() const { return presentMode; }
+    [[nodiscard]] inline VkExtent2D getExtent() const { return extent; }
     [[nodiscard]] inline const Vec<VkSurfaceFormatKHR>& getSupportedFormats() const {
         return supportedFormats;
     }
@@ -64,6 +73,7 @@ class Surface {
    private:
     void createSurface();
     void getSurfaceSupport();
+    void updateSurfaceCapabilities();
     void createSwapchain();
     void destroySwapchain();
 };
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <thread>
+
+#include "Core/Core.hpp"
+#include "Core/MpmcQueue.hpp"
+#include "Core/SpscQueue.hpp"
+
+// Throughput and round trip latency of the ring queues, with single and batch operations. Only meaningful in
+// release builds
+
+using Clock = std::chrono::steady_clock;
+
+const u64 QUEUE_CAPACITY = 1024;
+const u64 ITEM_COUNT     = 1 << 24;
+const u64 BATCH_SIZE     = 32;
+const u64 ROUND_TRIPS    = 100000;
+const u64 STOP           = UINT64_MAX;  ///< Pushed after all items, every consumer stops at one
+
+using Spsc = SpscQueue<u64, QUEUE_CAPACITY>;
+using Mpmc = MpmcQueue<u64, QUEUE_CAPACITY>;
+
+static f64 secondsSince(Clock::time_point start) {
+    return std::chrono::duration<f64>(Clock::now() - start).count();
+}
+
+// Neither queue blocks on batch pushes, whatever didn't fit is retried
+template <typename Queue>
+static void pushBatch(Queue& queue, u64* items, u64 count) {
+    while (count > 0) {
+        u64 n = queue.tryPushBatch(items, count);
+        if (n == 0) std::this_thread::yield();
+        items += n, count -= n;
+    }
+}
+
+template <typename Queue>
+static void produce(Queue& queue, u64 begin, u64 end, bool batch) {
+    if (!batch) {
+        for (u64 i = begin; i < end; i++) queue.push(u64(i));
+        return;
+    }
+
+    u64 items[BATCH_SIZE];
+    for (u64 i = begin; i < end; i += BATCH_SIZE) {
+        u64 count = std::min(BATCH_SIZE, end - i);
+        for (u64 j = 0; j < count; j++) items[j] = i + j;
+        pushBatch(queue, items, count);
+    }
+}
+
+/// Returns the sum of the items popped before the stop
+template <typename Queue>
+static u64 consume(Queue& queue, bool batch) {
+    u64 sum = 0;
+    u64 items[BATCH_SIZE];
+    while (true) {
+        u64 n = 1;
+        if (batch)
+            n = queue.popBatch(items, BATCH_SIZE);
+        else
+            queue.pop(items[0]);
+
+        u64 stops = 0;
+        for (u64 i = 0; i < n; i++) {
+            if (items[i] == STOP)
+                stops++;
+            else
+                sum += items[i];
+        }
+        if (stops == 0) continue;
+
+        // The stops are queued after every item, a batch with several of them took those of other consumers
+        for (u64 i = 1; i < stops; i++) queue.push(u64(STOP));
+        return sum;
+    }
+}
+
+/// Moves the items 1 to ITEM_COUNT from the producers to the consumers and checks that each arrived once
+template <typename Queue>
+static void benchmarkThroughput(const char* name, u32 producers, u32 consumers, bool batch) {
+    Queue queue;
+    Vec<std::thread> threads(producers + consumers);
+    Vec<u64> sums(consumers);
+
+    auto start = Clock::now();
+    for (u32 i = 0; i < consumers; i++)
+        threads[producers + i] = std::thread([&, i]() { sums[i] = consume(queue, batch); });
+    for (u32 i = 0; i < producers; i++) {
+        u64 begin  = 1 + ITEM_COUNT * i / producers;
+        u64 end    = 1 + ITEM_COUNT * (i + 1) / producers;
+        threads[i] = std::thread([&, begin, end]() { produce(queue, begin, end, batch); });
+    }
+
+    // Once the producers are joined this thread is the only producer left, which also holds for SPSC
+    for (u32 i = 0; i < producers; i++) threads[i].join();
+    for (u32 i = 0; i < consumers; i++) queue.push(u64(STOP));
+    for (u32 i = 0; i < consumers; i++) threads[producers + i].join();
+    f64 seconds = secondsSince(start);
+
+    u64 sum = 0;
+    for (u64 s : sums) sum += s;
+    if (sum != ITEM_COUNT * (ITEM_COUNT + 1) / 2)
+        throw std::runtime_error(
+            std::format("{} {}:{} lost or duplicated items", name, producers, consumers));
+
+    println("{:<4} {:>2}:{:<2} {:<6} {:>8.1f} M items/s {:>7.2f} ns/item",
+            name,
+            producers,
+            consumers,
+            batch ? "batch" : "single",
+            (f64)ITEM_COUNT / seconds / 1e6,
+            seconds * 1e9 / (f64)ITEM_COUNT);
+}
+
+/// Sends one item back and forth between two threads through a pair of queues, blocking on both sides
+template <typename Queue>
+static void benchmarkLatency(const char* name) {
+    Queue ping, pong;
+    std::thread echo([&]() {
+        u64 x;
+        do {
+            ping.pop(x);
+            pong.push(u64(x));
+        } while (x != STOP);
+    });
+
+    Vec<u64> roundTrips(ROUND_TRIPS);
+    u64 x;
+    for (u64 i = 0; i < ROUND_TRIPS; i++) {
+        auto start = Clock::now();
+        ping.push(u64(i));
+        pong.pop(x);
+        roundTrips[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+    ping.push(u64(STOP));
+    pong.pop(x);
+    echo.join();
+
+    std::sort(roundTrips.getData(), roundTrips.getData() + ROUND_TRIPS);
+    println("{:<4} median {:>6} ns, p99 {:>6} ns, max {:>8} ns",
+            name,
+            roundTrips[ROUND_TRIPS / 2],
+            roundTrips[ROUND_TRIPS * 99 / 100],
+            roundTrips[ROUND_TRIPS - 1]);
+}
+
+int main(i32 argc, char** argv) {
+    u32 hardwareThreads = std::max(std::thread::hardware_concurrency(), 2u);
+
+    println(
+        "Throughput of {} items through {} slots, batches of {}:", ITEM_COUNT, QUEUE_CAPACITY, BATCH_SIZE);
+    for (bool batch : {false, true}) benchmarkThroughput<Spsc>("SPSC", 1, 1, batch);
+    for (u32 threads = 1; threads * 2 <= hardwareThreads; threads *= 2)
+        for (bool batch : {false, true}) benchmarkThroughput<Mpmc>("MPMC", threads, threads, batch);
+    if (hardwareThreads > 2) {
+        for (bool batch : {false, true}) benchmarkThroughput<Mpmc>("MPMC", hardwareThreads - 1, 1, batch);
+        for (bool batch : {false, true}) benchmarkThroughput<Mpmc>("MPMC", 1, hardwareThreads - 1, batch);
+    }
+
+    println("Round trip latency over {} round trips:", ROUND_TRIPS);
+    benchmarkLatency<Spsc>("SPSC");
+    benchmarkLatency<Mpmc>("MPMC");
+}
@@ -0,0 +1,516 @@
+#include "RenderGraph.hpp"
+
+#include <algorithm>
+
+namespace {
+struct UsageInfo {
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2 access;
+    VkImageLayout layout;
+    VkImageUsageFlags imageUsage;
+    bool write;
+};
+}  // namespace
+
+static const VkAccessFlags2 WRITE_ACCESS_MASK =
+    VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+static UsageInfo getUsageInfo(GraphUsage usage) {
+    switch (usage) {
+        case GraphUsage::ColorAttachment:
+            return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                    true};
+        case GraphUsage::DepthAttachment:
+            return {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                        VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                    true};
+        case GraphUsage::SampledFragment:
+            return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+                    VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_IMAGE_USAGE_SAMPLED_BIT,
+                    false};
+        case GraphUsage::SampledCompute:
+            return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_IMAGE_USAGE_SAMPLED_BIT,
+                    false};
+        case GraphUsage::StorageRead:
+            return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL,
+                    VK_IMAGE_USAGE_STORAGE_BIT,
+                    false};
+        case GraphUsage::StorageWrite:
+            return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL,
+                    VK_IMAGE_USAGE_STORAGE_BIT,
+                    true};
+        case GraphUsage::TransferSrc:
+            return {VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                    VK_ACCESS_2_TRANSFER_READ_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                    false};
+        case GraphUsage::TransferDst:
+            return {VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                    VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                    true};
+        case GraphUsage::VertexBuffer:
+            return {VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT,
+                    VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED,
+                    0,
+                    false};
+        case GraphUsage::IndexBuffer:
+            return {VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT,
+                    VK_ACCESS_2_INDEX_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED,
+                    0,
+                    false};
+        case GraphUsage::IndirectBuffer:
+            return {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+                    VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED,
+                    0,
+                    false};
+        case GraphUsage::UniformBuffer:
+            return {VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT |
+                        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_2_UNIFORM_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED,
+                    0,
+                    false};
+    }
+    throw std::runtime_error("Invalid graph usage");
+}
+
+static VkImageAspectFlags getAspect(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT: return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT: return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        case VK_FORMAT_S8_UINT: return VK_IMAGE_ASPECT_STENCIL_BIT;
+        default: return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+GraphPass::GraphPass(const char* _name) : name(_name) {}
+
+GraphPass& GraphPass::use(GraphImage image, GraphUsage usage) {
+    imageAccesses.push({image, usage});
+    return *this;
+}
+
+GraphPass& GraphPass::use(GraphBuffer buffer, GraphUsage usage) {
+    bufferAccesses.push({buffer, usage});
+    return *this;
+}
+
+GraphPass& GraphPass::setExecute(const std::function<void(CmdBuffer*)>& _execute) {
+    execute = _execute;
+    return *this;
+}
+
+GraphPass& GraphPass::setSideEffects() {
+    sideEffects = true;
+    return *this;
+}
+
+bool RenderGraph::TransientKey::operator==(const TransientKey& rhs) const {
+    return format == rhs.format and width == rhs.width and height == rhs.height and samples == rhs.samples and
+           usage == rhs.usage and firstPass == rhs.firstPass and lastPass == rhs.lastPass;
+}
+
+RenderGraph::RenderGraph(Device* _device) : device(_device) {}
+
+RenderGraph::~RenderGraph() { releaseTransients(); }
+
+void RenderGraph::reset() {
+    passes.clear();
+    images.clear();
+    buffers.clear();
+    compiled = false;
+}
+
+GraphImage RenderGraph::importImage(ImageHandle image, ImageViewHandle view, VkImageLayout initialLayout,
+                                    VkImageLayout finalLayout, VkPipelineStageFlags2 initialStages) {
+    ImageResource resource{
+        .imported      = true,
+        .image         = image,
+        .view          = view,
+        .finalLayout   = finalLayout,
+        .initialStages = initialStages,
+    };
+    resource.state.layout = initialLayout;
+    images.push(resource);
+    return {(u32)images.getSize() - 1};
+}
+
+GraphImage RenderGraph::createImage(const GraphImageDesc& desc) {
+    images.push({.desc = desc});
+    return {(u32)images.getSize() - 1};
+}
+
+GraphBuffer RenderGraph::importBuffer(BufferHandle buffer) {
+    buffers.push({.buffer = buffer});
+    return {(u32)buffers.getSize() - 1};
+}
+
+GraphPass& RenderGraph::addPass(const char* name) {
+    passes.push(GraphPass(name));
+    return passes[passes.getSize() - 1];
+}
+
+void RenderGraph::compile() {
+    cullPasses();
+    computeLifetimes();
+    allocateTransients();
+    compiled = true;
+}
+
+void RenderGraph::execute(CmdBuffer* cmdBuffer) {
+    if (!compiled) compile();
+    resolveResources();
+
+    for (auto& pass : passes) {
+        if (pass.culled) continue;
+
+        for (const auto& a : pass.imageAccesses) imageBarrier(cmdBuffer, images[a.image.id], a.usage);
+        for (const auto& a : pass.bufferAccesses) bufferBarrier(cmdBuffer, buffers[a.buffer.id], a.usage);
+        if (pass.execute) pass.execute(cmdBuffer);
+    }
+
+    // Imported images leave the graph in their final layout, e.g. for presenting
+    for (auto& image : images) {
+        if (!image.imported or image.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED or
+            image.finalLayout == image.state.layout)
+            continue;
+
+        cmdBuffer->imageMemoryBarrier({
+            .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .srcStageMask        = image.state.writeStages | image.state.readStages | image.initialStages,
+            .srcAccessMask       = image.state.writeAccess,
+            .dstStageMask        = VK_PIPELINE_STAGE_2_NONE,
+            .dstAccessMask       = VK_ACCESS_2_NONE,
+            .oldLayout           = image.state.layout,
+            .newLayout           = image.finalLayout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image               = image.vkImage,
+            .subresourceRange    = {getAspect(image.vkFormat), 0, VK_REMAINING_MIP_LEVELS, 0,
+                                    VK_REMAINING_ARRAY_LAYERS},
+        });
+        image.state.layout = image.finalLayout;
+    }
+    cmdBuffer->flushBarriers();
+}
+
+Image* RenderGraph::getImage(GraphImage image) { return device->get(images[image.id].image); }
+
+ImageView* RenderGraph::getImageView(GraphImage image) { return device->get(images[image.id].view); }
+
+Buffer* RenderGraph::getBuffer(GraphBuffer buffer) { return device->get(buffers[buffer.id].buffer); }
+
+void RenderGraph::cullPasses() {
+    // Imported resources are used after the graph, everything else only if a kept pass reads it
+    for (auto& image : images) image.needed = image.imported;
+    for (auto& buffer : buffers) buffer.needed = true;
+
+    for (u64 i = passes.getSize(); i-- > 0;) {
+        GraphPass& pass = passes[i];
+
+        bool keep = pass.sideEffects;
+        for (const auto& a : pass.imageAccesses)
+            keep = keep or (getUsageInfo(a.usage).write and images[a.image.id].needed);
+        for (const auto& a : pass.bufferAccesses)
+            keep = keep or (getUsageInfo(a.usage).write and buffers[a.buffer.id].needed);
+
+        pass.culled = !keep;
+        if (pass.culled) continue;
+
+        for (const auto& a : pass.imageAccesses)
+            if (!getUsageInfo(a.usage).write) images[a.image.id].needed = true;
+        for (const auto& a : pass.bufferAccesses)
+            if (!getUsageInfo(a.usage).write) buffers[a.buffer.id].needed = true;
+    }
+}
+
+void RenderGraph::computeLifetimes() {
+    for (u32 i = 0; i < passes.getSize(); i++) {
+        if (passes[i].culled) continue;
+
+        for (const auto& a : passes[i].imageAccesses) {
+            ImageResource& image = images[a.image.id];
+            image.firstPass      = std::min(image.firstPass, i);
+            image.lastPass       = std::max(image.lastPass, i);
+            image.usage         |= getUsageInfo(a.usage).imageUsage;
+        }
+    }
+}
+
+void RenderGraph::resolveResources() {
+    auto lock = device->lockObjects();
+    for (auto& image : images) {
+        if (Image* img = device->get(image.image)) {
+            image.vkImage  = img->getVkImage();
+            image.vkFormat = img->getVkFormat();
+        }
+        if (ImageView* view = device->get(image.view)) image.vkView = view->getVkImageView();
+    }
+    for (auto& buffer : buffers) {
+        if (Buffer* b = device->get(buffer.buffer)) buffer.vkBuffer = b->getVkBuffer();
+    }
+}
+
+void RenderGraph::allocateTransients() {
+    Vec<TransientKey> keys;
+    for (const auto& image : images) {
+        if (image.imported or image.firstPass == UINT32_MAX) continue;
+        keys.push({
+            .format    = image.desc.format,
+            .width     = image.desc.width,
+            .height    = image.desc.height,
+            .samples   = image.desc.samples,
+            .usage     = image.usage,
+            .firstPass = image.firstPass,
+            .lastPass  = image.lastPass,
+        });
+    }
+
+    bool cached = keys.getSize() == cachedKeys.getSize();
+    for (u64 i = 0; cached and i < keys.getSize(); i++) cached = keys[i] == cachedKeys[i];
+
+    if (!cached) {
+        releaseTransients();
+        VkDevice vkDevice = device->getVkDevice();
+
+        Vec<VkMemoryRequirements> requirements(keys.getSize());
+        for (u64 i = 0; i < keys.getSize(); i++) {
+            const TransientKey& key = keys[i];
+            VkImageCreateInfo createInfo{
+                .sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                .imageType     = VK_IMAGE_TYPE_2D,
+                .format        = key.format,
+                .extent        = {key.width, key.height, 1},
+                .mipLevels     = 1,
+                .arrayLayers   = 1,
+                .samples       = key.samples,
+                .tiling        = VK_IMAGE_TILING_OPTIMAL,
+                .usage         = key.usage,
+                .sharingMode   = VK_SHARING_MODE_EXCLUSIVE,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            };
+            PhysicalImage physical{
+                .block     = UINT32_MAX,
+                .firstPass = key.firstPass,
+                .lastPass  = key.lastPass,
+            };
+            vkCreateImage(vkDevice, &createInfo, nullptr, &physical.vkImage);
+            vkGetImageMemoryRequirements(vkDevice, physical.vkImage, &requirements[i]);
+            physicalImages.push(physical);
+        }
+
+        // Largest images first, each goes into the first block whose images it doesn't overlap in time with
+        Vec<u32> order;
+        for (u32 i = 0; i < keys.getSize(); i++) order.push(i);
+        std::sort(order.getData(), order.getData() + order.getSize(), [&](u32 a, u32 b) {
+            return requirements[a].size > requirements[b].size;
+        });
+
+        for (u32 i : order) {
+            PhysicalImage& physical         = physicalImages[i];
+            const VkMemoryRequirements& req = requirements[i];
+
+            for (u32 b = 0; b < memoryBlocks.getSize() and physical.block == UINT32_MAX; b++) {
+                VkMemoryRequirements& blockReq = memoryBlocks[b].requirements;
+                if (!(blockReq.memoryTypeBits & req.memoryTypeBits)) continue;
+
+                bool overlaps = false;
+                for (const auto& other : physicalImages) {
+                    overlaps = overlaps or (other.block == b and other.firstPass <= physical.lastPass and
+                                            physical.firstPass <= other.lastPass);
+                }
+                if (overlaps) continue;
+
+                blockReq.size            = std::max(blockReq.size, req.size);
+                blockReq.alignment       = std::max(blockReq.alignment, req.alignment);
+                blockReq.memoryTypeBits &= req.memoryTypeBits;
+                physical.block           = b;
+            }
+
+            if (physical.block == UINT32_MAX) {
+                physical.block = (u32)memoryBlocks.getSize();
+                memoryBlocks.push({.requirements = req});
+            }
+        }
+
+        VmaAllocationCreateInfo allocationCreateInfo{
+            .preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        };
+        for (auto& block : memoryBlocks) {
+            vmaAllocateMemory(device->getVmaAllocator(),
+                              &block.requirements,
+                              &allocationCreateInfo,
+                              &block.allocation,
+                              nullptr);
+        }
+
+        for (u64 i = 0; i < keys.getSize(); i++) {
+            PhysicalImage& physical = physicalImages[i];
+            vmaBindImageMemory(
+                device->getVmaAllocator(), memoryBlocks[physical.block].allocation, physical.vkImage);
+            physical.image = device->createImage(physical.vkImage, keys[i].format);
+            physical.view  = device->createImageView(physical.image, getAspect(keys[i].format));
+        }
+
+        cachedKeys = keys;
+    }
+
+    u32 next = 0;
+    for (auto& image : images) {
+        if (image.imported or image.firstPass == UINT32_MAX) continue;
+        image.physical = next++;
+        image.image    = physicalImages[image.physical].image;
+        image.view     = physicalImages[image.physical].view;
+    }
+}
+
+void RenderGraph::releaseTransients() {
+    if (physicalImages.getSize() == 0) return;
+
+    // Images may still be used by submitted frames
+    Device* d = device;
+    device->destroyDeferred([d, oldImages = Vec<PhysicalImage>(std::move(physicalImages)),
+                             oldBlocks = Vec<MemoryBlock>(std::move(memoryBlocks))]() {
+        for (const auto& p : oldImages) {
+            d->destroy(p.view);
+            d->destroy(p.image);
+            vkDestroyImage(d->getVkDevice(), p.vkImage, nullptr);
+        }
+        for (const auto& b : oldBlocks) vmaFreeMemory(d->getVmaAllocator(), b.allocation);
+    });
+    cachedKeys.clear();
+}
+
+bool RenderGraph::applyAccess(AccessState& state, GraphUsage usage, bool isImage,
+                              VkPipelineStageFlags2& srcStages, VkAccessFlags2& srcAccess) {
+    UsageInfo info       = getUsageInfo(usage);
+    VkImageLayout layout = isImage ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+    bool layoutChange    = layout != state.layout;
+
+    bool needed;
+    if (info.write or layoutChange) {
+        // Write after write or read, layout transitions also write the image
+        srcStages = state.writeStages | state.readStages;
+        srcAccess = state.writeAccess;
+        needed    = srcStages != VK_PIPELINE_STAGE_2_NONE or layoutChange;
+    } else {
+        // Read after write, only if the write hasn't been made visible to this stage and access yet
+        bool visible = !(info.stages & ~state.readStages) and !(info.access & ~state.readAccess);
+        srcStages    = state.writeStages;
+        srcAccess    = state.writeAccess;
+        needed       = state.writeStages != VK_PIPELINE_STAGE_2_NONE and !visible;
+    }
+
+    if (info.write) {
+        state.writeStages = info.stages;
+        state.writeAccess = info.access & WRITE_ACCESS_MASK;
+        state.readStages  = VK_PIPELINE_STAGE_2_NONE;
+        state.readAccess  = VK_ACCESS_2_NONE;
+    } else if (layoutChange) {
+        // Later reads in other stages have to wait for the transition
+        state.writeStages = info.stages;
+        state.writeAccess = VK_ACCESS_2_NONE;
+        state.readStages  = info.stages;
+        state.readAccess  = info.access;
+    } else {
+        state.readStages |= info.stages;
+        state.readAccess |= info.access;
+    }
+    state.layout = layout;
+
+    return needed;
+}
+
+void RenderGraph::imageBarrier(CmdBuffer* cmdBuffer, ImageResource& image, GraphUsage usage) {
+    if (!image.started) {
+        image.started = true;
+        if (image.imported) {
+            image.state.writeStages = image.initialStages;
+        } else {
+            // Wait for the last image that used the same memory, this frame or the previous execution
+            MemoryBlock& block = memoryBlocks[physicalImages[image.physical].block];
+            if (block.lastImage != UINT32_MAX) {
+                image.state.writeStages = physicalImages[block.lastImage].lastStages;
+                image.state.writeAccess = physicalImages[block.lastImage].lastAccess;
+            }
+            block.lastImage = image.physical;
+        }
+    }
+
+    VkImageLayout oldLayout = image.state.layout;
+    VkPipelineStageFlags2 srcStages;
+    VkAccessFlags2 srcAccess;
+    bool needed = applyAccess(image.state, usage, true, srcStages, srcAccess);
+
+    if (!image.imported) {
+        PhysicalImage& physical = physicalImages[image.physical];
+        physical.lastStages     = image.state.writeStages | image.state.readStages;
+        physical.lastAccess     = image.state.writeAccess;
+    }
+
+    if (!needed) return;
+
+    UsageInfo info = getUsageInfo(usage);
+    cmdBuffer->imageMemoryBarrier({
+        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask        = srcStages,
+        .srcAccessMask       = srcAccess,
+        .dstStageMask        = info.stages,
+        .dstAccessMask       = info.access,
+        .oldLayout           = oldLayout,
+        .newLayout           = info.layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = image.vkImage,
+        .subresourceRange    = {getAspect(image.vkFormat), 0, VK_REMAINING_MIP_LEVELS, 0,
+                                VK_REMAINING_ARRAY_LAYERS},
+    });
+}
+
+void RenderGraph::bufferBarrier(CmdBuffer* cmdBuffer, BufferResource& buffer, GraphUsage usage) {
+    VkPipelineStageFlags2 srcStages;
+    VkAccessFlags2 srcAccess;
+    if (!applyAccess(buffer.state, usage, false, srcStages, srcAccess)) return;
+
+    UsageInfo info = getUsageInfo(usage);
+    cmdBuffer->bufferMemoryBarrier({
+        .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .srcStageMask        = srcStages,
+        .srcAccessMask       = srcAccess,
+        .dstStageMask        = info.stages,
+        .dstAccessMask       = info.access,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer              = buffer.vkBuffer,
+        .offset              = 0,
+        .size                = VK_WHOLE_SIZE,
+    });
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#include "GpuApi/GpuApi.hpp"
+
+/// How a pass uses an image or buffer, determines the barriers and image layouts the graph inserts
+enum class GraphUsage : u8 {
+    ColorAttachment,
+    DepthAttachment,
+    SampledFragment,
+    SampledCompute,
+    StorageRead,
+    StorageWrite,
+    TransferSrc,
+    TransferDst,
+    VertexBuffer,
+    IndexBuffer,
+    IndirectBuffer,
+    UniformBuffer,
+};
+
+struct GraphImage {
+    u32 id = UINT32_MAX;
+};
+
+struct GraphBuffer {
+    u32 id = UINT32_MAX;
+};
+
+/// Transient image, its usage flags are derived from how the passes use it
+struct GraphImageDesc {
+    VkFormat format;
+    u32 width, height;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+};
+
+class RenderGraph;
+
+class GraphPass {
+    friend RenderGraph;
+
+   private:
+    struct ImageAccess {
+        GraphImage image;
+        GraphUsage usage;
+    };
+    struct BufferAccess {
+        GraphBuffer buffer;
+        GraphUsage usage;
+    };
+
+    const char* name;
+    Vec<ImageAccess> imageAccesses;
+    Vec<BufferAccess> bufferAccesses;
+    std::function<void(CmdBuffer*)> execute;
+    bool sideEffects = false;
+    bool culled      = false;
+
+   public:
+    explicit GraphPass(const char* name);
+
+    GraphPass& use(GraphImage image, GraphUsage usage);
+    GraphPass& use(GraphBuffer buffer, GraphUsage usage);
+
+    /// Records the pass, the graph has already inserted the barriers for the declared usages
+    GraphPass& setExecute(const std::function<void(CmdBuffer*)>& execute);
+
+    /// Never culled, for passes whose results leave the graph without an imported resource
+    GraphPass& setSideEffects();
+
+    [[nodiscard]] inline const char* getName() const { return name; }
+    [[nodiscard]] inline bool isCulled() const { return culled; }
+};
+
+/**
+ * @brief Frame render graph that derives barriers, culls unused passes and aliases transient images.
+ *
+ * Passes are recorded in declaration order, which is always a valid order since a resource has to be
+ * written by an earlier pass before it can be read. A pass is culled if nothing it writes is read by a
+ * later pass that is kept, written to an imported resource or marked as having side effects.
+ *
+ * Transient images whose lifetimes (first to last pass using them) don't overlap share VMA memory. The
+ * physical images are cached and reused as long as the transient images and their lifetimes don't change
+ * from one frame to the next, so the graph is meant to be rebuilt every frame with reset().
+ *
+ * All passes are recorded into one command buffer. Barriers for the first use of a resource also cover
+ * work submitted earlier on the same queue, so previous executions of the graph are synchronized with.
+ */
+class RenderGraph {
+   private:
+    // Access state since the last write, used to derive the barrier for the next access
+    struct AccessState {
+        VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 writeAccess        = VK_ACCESS_2_NONE;
+        // Stages and accesses that read since the last write, which is visible to them
+        VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 readAccess        = VK_ACCESS_2_NONE;
+        VkImageLayout layout             = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    struct ImageResource {
+        GraphImageDesc desc;
+        VkImageUsageFlags usage = 0;
+        bool imported           = false;
+        ImageHandle image;
+        ImageViewHandle view;
+        VkImageLayout finalLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags2 initialStages = VK_PIPELINE_STAGE_2_NONE;
+        u32 firstPass = UINT32_MAX, lastPass = 0;
+        u32 physical  = UINT32_MAX;  ///< Index into physicalImages for transient images
+        bool needed   = false;
+        bool started  = false;
+        AccessState state;
+        // Resolved from the handles once per execution, see resolveResources
+        VkImage vkImage{};
+        VkFormat vkFormat{};
+        VkImageView vkView{};
+    };
+
+    struct BufferResource {
+        BufferHandle buffer;
+        bool needed = false;
+        AccessState state;
+        VkBuffer vkBuffer{};
+    };
+
+    // Transient image allocated by the graph, reused while the transient images don't change
+    struct PhysicalImage {
+        VkImage vkImage{};
+        ImageHandle image;
+        ImageViewHandle view;
+        u32 block;
+        u32 firstPass, lastPass;
+        // State at the end of the last execution, waited on by the next image using the memory
+        VkPipelineStageFlags2 lastStages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 lastAccess        = VK_ACCESS_2_NONE;
+    };
+
+    struct MemoryBlock {
+        VkMemoryRequirements requirements;
+        VmaAllocation allocation{};
+        u32 lastImage = UINT32_MAX;  ///< Physical image that used the memory last during the execution
+    };
+
+    struct TransientKey {
+        VkFormat format;
+        u32 width, height;
+        VkSampleCountFlagBits samples;
+        VkImageUsageFlags usage;
+        u32 firstPass, lastPass;
+
+        bool operator==(const TransientKey& rhs) const;
+    };
+
+    Device* device;
+
+    Vec<GraphPass> passes;
+    Vec<ImageResource> images;
+    Vec<BufferResource> buffers;
+
+    Vec<TransientKey> cachedKeys;
+    Vec<PhysicalImage> physicalImages;
+    Vec<MemoryBlock> memoryBlocks;
+
+    bool compiled = false;
+
+   public:
+    explicit RenderGraph(Device* device);
+    ~RenderGraph();
+
+    RenderGraph(const RenderGraph&)            = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    /// Clears passes and resources, allocated transient images are kept for the next frame
+    void reset();
+
+    /**
+     * @brief Imports an image owned outside of the graph, such as a swapchain image.
+     *
+     * @param initialLayout Layout of the image when the graph starts executing.
+     * @param finalLayout Layout the image is transitioned to after the last pass, or UNDEFINED to keep the
+     * layout of the last use.
+     * @param initialStages Stages the first barrier waits on, e.g. the wait stage of the acquire semaphore.
+     */
+    GraphImage importImage(ImageHandle image, ImageViewHandle view, VkImageLayout initialLayout,
+                           VkImageLayout finalLayout,
+                           VkPipelineStageFlags2 initialStages = VK_PIPELINE_STAGE_2_NONE);
+    GraphImage createImage(const GraphImageDesc& desc);
+    GraphBuffer importBuffer(BufferHandle buffer);
+
+    /// The returned reference is only valid until the next addPass call
+    GraphPass& addPass(const char* name);
+
+    /// Culls passes, computes lifetimes and allocates transient images
+    void compile();
+
+    /// Records the passes that weren't culled and their barriers, compiles the graph first if needed
+    void execute(CmdBuffer* cmdBuffer);
+
+    /// Valid inside the execute callback of a pass, while holding Device::lockObjects
+    Image* getImage(GraphImage image);
+    ImageView* getImageView(GraphImage image);
+    Buffer* getBuffer(GraphBuffer buffer);
+
+    /// Valid inside the execute callback of a pass, also without holding the lock
+    [[nodiscard]] inline VkImage getVkImage(GraphImage image) const { return images[image.id].vkImage; }
+    [[nodiscard]] inline VkImageView getVkImageView(GraphImage image) const {
+        return images[image.id].vkView;
+    }
+    [[nodiscard]] inline VkBuffer getVkBuffer(GraphBuffer buffer) const {
+        return buffers[buffer.id].vkBuffer;
+    }
+
+    [[nodiscard]] inline u32 getPassCount() const { return (u32)passes.getSize(); }
+    [[nodiscard]] inline u32 getMemoryBlockCount() const { return (u32)memoryBlocks.getSize(); }
+
+   private:
+    /**
+     * @brief Looks up the Vulkan objects of every resource while holding the object lock.
+     *
+     * Pointers into the device pools move whenever another thread creates or destroys an object, so only
+     * the handles are kept and the passes are recorded without holding the lock.
+     */
+    void resolveResources();
+    void cullPasses();
+    void computeLifetimes();
+    void allocateTransients();
+    void releaseTransients();
+
+    /// Updates the state for an access, returns whether a barrier with the given source scope is needed
+    static bool applyAccess(AccessState& state, GraphUsage usage, bool isImage,
+                            VkPipelineStageFlags2& srcStages, VkAccessFlags2& srcAccess);
+
+    void imageBarrier(CmdBuffer* cmdBuffer, ImageResource& image, GraphUsage usage);
+    void bufferBarrier(CmdBuffer* cmdBuffer, BufferResource& buffer, GraphUsage usage);
+};
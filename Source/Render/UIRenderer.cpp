@@ -1,20 +1,18 @@
 #include "UIRenderer.hpp"
 
-Vec<u8> readFile(const char *path) {
-    std::ifstream f(path, std::ios::ate | std::ios::binary);
-    if (!f) throw std::runtime_error(std::format("Failed to open file: {}", path));
-    u64 size = f.tellg();
-    Vec<u8> buf(size);
-    f.seekg(0);
-    f.read((char *)buf.getData(), (i64)size);
-    f.close();
-    return buf;
-}
+#include "Shaders/UIRoundedRect.hpp"
+#include "Shaders/UIVertex.hpp"
+
+// Below this many draws recording in parallel costs more than it saves
+const u64 PARALLEL_MIN_DRAWS = 256;
+const u64 DRAWS_PER_CHUNK    = 128;
+
+UIRenderer::UIRenderer(Device *_device, JobSystem *_jobSystem, Surface *_surface, u32 _width, u32 _height)
+    : device(_device), surface(_surface), jobSystem(_jobSystem), width(_width), height(_height) {
+    queue = device->getGraphicsQueue();
 
-UIRenderer::UIRenderer(Device *_device, Surface *_surface, u32 _width, u32 _height)
-    : device(_device), surface(_surface), width(_width), height(_height) {
-    queue     = device->getGraphicsQueue();
-    cmdBuffer = new CmdBuffer(device->getGraphicsCmdPool());
+    u32 threadCount = jobSystem ? jobSystem->getThreadCount() : 1;
+    cmdPools        = new FrameCmdPools(device, queue->getFamilyIndex(), threadCount);
 
     renderingInfo = {
         .renderArea       = {{0, 0}, {width, height}},
@@ -27,19 +25,23 @@ UIRenderer::UIRenderer(Device *_device, Surface *_surface, u32 _width, u32 _heig
     };
 
     fence = new Fence(device, true);
+    graph = new RenderGraph(device);
 
+    // The SPIR-V is embedded, creating the shaders reads no files
     ShaderDesc vsDesc = {
         .stage     = VK_SHADER_STAGE_VERTEX_BIT,
         .nextStage = VK_SHADER_STAGE_FRAGMENT_BIT,
         .codeType  = VK_SHADER_CODE_TYPE_SPIRV_EXT,
-        .code      = readFile("Shaders/UIVertex.vert.spv"),
+        .code      = UIVertexSpv,
+        .codeSize  = sizeof(UIVertexSpv),
         .name      = "main",
     };
     ShaderDesc roundedBoxDesc = {
         .stage              = VK_SHADER_STAGE_FRAGMENT_BIT,
         .nextStage          = 0,
         .codeType           = VK_SHADER_CODE_TYPE_SPIRV_EXT,
-        .code               = readFile("Shaders/UIRoundedRect.frag.spv"),
+        .code               = UIRoundedRectSpv,
+        .codeSize           = sizeof(UIRoundedRectSpv),
         .name               = "main",
         .pushConstantRanges = {VkPushConstantRange{
             .offset = 0,
@@ -47,8 +49,8 @@ UIRenderer::UIRenderer(Device *_device, Surface *_surface, u32 _width, u32 _heig
         }},
     };
 
-    vs               = new Shader(device, vsDesc);
-    roundedBoxShader = new Shader(device, roundedBoxDesc);
+    vs               = device->createShader(vsDesc);
+    roundedBoxShader = device->createShader(roundedBoxDesc);
 
     Vec<Vec2> vertices = {
         {-1.0, -1.0},
@@ -58,25 +60,64 @@ UIRenderer::UIRenderer(Device *_device, Surface *_surface, u32 _width, u32 _heig
         {1.0, -1.0},
         {1.0, 1.0},
     };
-    vertexBuffer = new CpuVisibleBuffer(device, 6 * sizeof(Vec2), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-    memcpy(vertexBuffer->getData(), vertices.getData(), 6 * sizeof(Vec2));
+    vertexBuffer = device->createBuffer(
+        6 * sizeof(Vec2),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+    auto lock = device->lockObjects();
+    memcpy(device->get(vertexBuffer)->getData(), vertices.getData(), 6 * sizeof(Vec2));
+    vkVertexBuffer     = device->get(vertexBuffer)->getVkBuffer();
+    vkVs               = device->get(vs)->getVkShader();
+    vkRoundedBoxShader = device->get(roundedBoxShader)->getVkShader();
+    roundedBoxLayout   = device->get(roundedBoxShader)->getVkPipelineLayout();
 }
 
 UIRenderer::~UIRenderer() {
-    delete vertexBuffer;
-    delete vs, delete roundedBoxShader;
-    delete fence;
-    delete cmdBuffer;
+    delete graph;
+    device->destroyDeferred(vertexBuffer);
+    device->destroyDeferred(vs), device->destroyDeferred(roundedBoxShader);
+
+    FrameCmdPools *pools = cmdPools;
+    Fence *f             = fence;
+    device->destroyDeferred([pools, f]() {
+        delete pools;
+        delete f;
+    });
 }
 
-void UIRenderer::render(const UIDrawData &drawData, u32 imageIndex, Semaphore *imageAvailable,
-                        Semaphore *renderFinished) {
+void UIRenderer::render(const UIDrawData &drawData, u32 imageIndex, const Damage &damage,
+                        Semaphore *imageAvailable, Semaphore *renderFinished) {
     fence->waitFor(UINT64_MAX);
     fence->reset();
 
-    renderingInfo.colorAttachments[0].imageView = surface->getImageViews()[imageIndex];
+    // The previous frame is done executing, its command buffers can be recycled
+    cmdPools->beginFrame();
+    cmdBuffer = cmdPools->getPool(0)->allocate();
 
-    recordCommandBuffer(drawData);
+    // A partial redraw relies on the first command covering the damage, without any the image is cleared
+    bool full = damage.full or drawData.getDrawCommands().getSize() == 0;
+
+    // Outside of the damage the image has to keep what it was last presented with
+    graph->reset();
+    GraphImage target = graph->importImage(surface->getImages()[imageIndex],
+                                           surface->getImageViews()[imageIndex],
+                                           full ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                           VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                           VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+    graph->addPass("UI")
+        .use(target, GraphUsage::ColorAttachment)
+        .setExecute([this, target, &drawData, &damage, full](CmdBuffer *) {
+            renderingInfo.colorAttachments[0].vkImageView = graph->getVkImageView(target);
+            if (full)
+                recordUIPass(drawData);
+            else
+                recordDamagedUIPass(drawData, damage.rects);
+        });
+
+    cmdBuffer->begin(true);
+    graph->execute(cmdBuffer);
+    cmdBuffer->end();
 
     queue->submit({cmdBuffer},
                   {imageAvailable},
@@ -85,66 +126,126 @@ void UIRenderer::render(const UIDrawData &drawData, u32 imageIndex, Semaphore *i
                   fence);
 }
 
-void UIRenderer::resize(u32 _width, u32 _height) {
-    width = _width, height = _height;
-    renderingInfo.renderArea.extent = {width, height};
+void UIRenderer::resize(u32 _width, u32 _height) { width = _width, height = _height; }
+
+void UIRenderer::recordUIPass(const UIDrawData &drawData) {
+    const Vec<UIDrawCmd> &commands = drawData.getDrawCommands();
+    u64 drawCount                  = commands.getSize();
+
+    renderingInfo.renderArea                 = {{0, 0}, {width, height}};
+    renderingInfo.colorAttachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+
+    if (drawCount < PARALLEL_MIN_DRAWS or !jobSystem or jobSystem->getThreadCount() == 1) {
+        setupUIState(cmdBuffer);
+        renderingInfo.secondaryContents = false;
+        cmdBuffer->beginRendering(renderingInfo);
+        recordDraws(cmdBuffer, commands, 0, drawCount);
+        cmdBuffer->endRendering();
+        return;
+    }
+
+    // Every chunk is recorded into a secondary command buffer from the pool of the thread recording it
+    u32 chunkCount = (u32)((drawCount + DRAWS_PER_CHUNK - 1) / DRAWS_PER_CHUNK);
+    Vec<CmdBuffer *> secondaryBuffers(chunkCount);
+    VkFormat format = surface->getFormat();
+    jobSystem->parallelFor(chunkCount, [&](u32 index, u32 thread) {
+        CmdBuffer *cmd = cmdPools->getPool(thread)->allocate(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+        cmd->beginSecondary({format});
+        setupUIState(cmd);
+        u64 begin = index * DRAWS_PER_CHUNK;
+        recordDraws(cmd, commands, begin, std::min(begin + DRAWS_PER_CHUNK, drawCount));
+        cmd->end();
+        secondaryBuffers[index] = cmd;
+    });
+
+    renderingInfo.secondaryContents = true;
+    cmdBuffer->beginRendering(renderingInfo);
+    cmdBuffer->executeCommands(secondaryBuffers);
+    cmdBuffer->endRendering();
 }
 
-void UIRenderer::recordCommandBuffer(const UIDrawData &drawData) {
-    cmdBuffer->begin();
-    cmdBuffer->defaultState();
-
-    cmdBuffer->setViewport({0.0, 0.0, (f32)width, (f32)height, 0.0, 1.0});
-    cmdBuffer->setScissor({{0, 0}, {width, height}});
-
-    cmdBuffer->setVertexInput({VertexBinding{
-                                  .binding   = 0,
-                                  .stride    = sizeof(Vec2),
-                                  .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-                              }},
-                              {VertexAttribute{
-                                  .location = 0,
-                                  .binding  = 0,
-                                  .offset   = 0,
-                                  .format   = VK_FORMAT_R32G32_SFLOAT,
-                              }});
-
-    cmdBuffer->setColorBlendEnable(0, false);
-    cmdBuffer->setColorBlendEquation(0,
-                                     VkColorBlendEquationEXT{
-                                         .srcColorBlendFactor = VK_BLEND_FACTOR_DST_ALPHA,
-                                         .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
-                                         .colorBlendOp        = VK_BLEND_OP_ADD,
-                                         .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_DST_ALPHA,
-                                         .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
-                                         .alphaBlendOp        = VK_BLEND_OP_ADD,
-                                     });
-
-    cmdBuffer->bindShader(VK_SHADER_STAGE_VERTEX_BIT, vs);
-    cmdBuffer->bindVertexBuffer(vertexBuffer, 0);
+// Damage is usually a few small rects, so it's recorded inline with one scissor per rect
+void UIRenderer::recordDamagedUIPass(const UIDrawData &drawData, const Vec<IRect> &rects) {
+    if (rects.getSize() == 0) return;  // Nothing changed, the graph still hands the image back for present
+
+    IRect area = rects[0];
+    for (const IRect &r : rects) area = area.merge(r);
+    renderingInfo.renderArea                 = {{area.x, area.y}, {(u32)area.w, (u32)area.h}};
+    renderingInfo.colorAttachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    renderingInfo.secondaryContents          = false;
 
+    const Vec<UIDrawCmd> &commands = drawData.getDrawCommands();
+    setupUIState(cmdBuffer);
     cmdBuffer->beginRendering(renderingInfo);
+    for (const IRect &rect : rects) {
+        cmdBuffer->setScissor({{rect.x, rect.y}, {(u32)rect.w, (u32)rect.h}});
 
-    u32 i = 0;
-    for (auto &cmd : drawData.getDrawCommands()) {
-        if (i == 1) cmdBuffer->setColorBlendEnable(0, true);  // first draw should not use blending
-        switch (cmd.kind) {
-            case UIDrawCmdKind::RoundedBox: {
-                // setVertexBufferRect(cmd.roundedBox.rect);
-
-                cmdBuffer->bindShader(VK_SHADER_STAGE_FRAGMENT_BIT, roundedBoxShader);
-                cmdBuffer->pushConstant(roundedBoxShader, 0, sizeof(UIDrawCmdRoundedBox), &cmd.roundedBox);
-                cmdBuffer->draw(6, 1, 0, 0);
-                break;
-            }
-            default: break;
-        }
-        i++;
+        // Every draw covers the whole scissor, so the unblended first one replaces what the image held there
+        // just like the clear of a full redraw. Of the others only the ones reaching into the rect matter
+        cmdBuffer->setColorBlendEnable(0, false);
+        recordDraw(cmdBuffer, commands[0]);
+        cmdBuffer->setColorBlendEnable(0, true);
+        for (u64 i = 1; i < commands.getSize(); i++)
+            if (DamageTracker::getBounds(commands[i]).intersects(rect)) recordDraw(cmdBuffer, commands[i]);
     }
-
     cmdBuffer->endRendering();
+}
 
-    cmdBuffer->end();
+// Secondary command buffers don't inherit any state, so it's set again for every one of them
+void UIRenderer::setupUIState(CmdBuffer *cmd) {
+    cmd->defaultState();
+
+    cmd->setViewport({0.0, 0.0, (f32)width, (f32)height, 0.0, 1.0});
+    cmd->setScissor({{0, 0}, {width, height}});
+
+    cmd->setVertexInput({VertexBinding{
+                            .binding   = 0,
+                            .stride    = sizeof(Vec2),
+                            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+                        }},
+                        {VertexAttribute{
+                            .location = 0,
+                            .binding  = 0,
+                            .offset   = 0,
+                            .format   = VK_FORMAT_R32G32_SFLOAT,
+                        }});
+
+    cmd->setColorBlendEquation(0,
+                               VkColorBlendEquationEXT{
+                                   .srcColorBlendFactor = VK_BLEND_FACTOR_DST_ALPHA,
+                                   .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+                                   .colorBlendOp        = VK_BLEND_OP_ADD,
+                                   .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_DST_ALPHA,
+                                   .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+                                   .alphaBlendOp        = VK_BLEND_OP_ADD,
+                               });
+
+    cmd->bindShader(VK_SHADER_STAGE_VERTEX_BIT, vkVs);
+    cmd->bindVertexBuffer(vkVertexBuffer, 0);
+}
+
+void UIRenderer::recordDraws(CmdBuffer *cmd, const Vec<UIDrawCmd> &commands, u64 begin, u64 end) {
+    // The first draw of the frame should not use blending
+    cmd->setColorBlendEnable(0, begin > 0);
+
+    for (u64 i = begin; i < end; i++) {
+        if (i == 1) cmd->setColorBlendEnable(0, true);
+        recordDraw(cmd, commands[i]);
+    }
+}
+
+void UIRenderer::recordDraw(CmdBuffer *cmd, const UIDrawCmd &draw) {
+    switch (draw.kind) {
+        case UIDrawCmdKind::RoundedBox: {
+            // setVertexBufferRect(draw.roundedBox.rect);
+            cmd->bindShader(VK_SHADER_STAGE_FRAGMENT_BIT, vkRoundedBoxShader);
+            cmd->pushConstant(roundedBoxLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(UIDrawCmdRoundedBox),
+                              &draw.roundedBox);
+            cmd->draw(6, 1, 0, 0);
+            break;
+        }
+        default: break;
+    }
 }
 
 void UIRenderer::setVertexBufferRect(const Rect &rect) {
@@ -152,5 +253,6 @@ void UIRenderer::setVertexBufferRect(const Rect &rect) {
     auto [x, y]        = rect.getPosition() / size * 2.0 - 1.0;
     auto [w, h]        = rect.getSize() / size * 2.0;
     Vec<Vec2> vertices = {{x, y}, {x + w, y}, {x, y + h}, {x + w, y}, {x + w, y + h}, {x, y + h}};
-    memcpy(vertexBuffer->getData(), vertices.getData(), 6 * sizeof(Vec2));
+    auto lock          = device->lockObjects();
+    memcpy(device->get(vertexBuffer)->getData(), vertices.getData(), 6 * sizeof(Vec2));
 }
\ No newline at end of file
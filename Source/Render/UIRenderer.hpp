@@ -1,6 +1,9 @@
 #pragma once
 
+#include "Core/JobSystem.hpp"
 #include "GpuApi/GpuApi.hpp"
+#include "RenderGraph.hpp"
+#include "UI/Damage.hpp"
 #include "UI/DrawData.hpp"
 
 class UIRenderer {
@@ -9,27 +12,49 @@ class UIRenderer {
     Surface* surface;
     RenderingInfo renderingInfo;
 
-    CmdBuffer* cmdBuffer;
+    JobSystem* jobSystem;
+    FrameCmdPools* cmdPools;
+    CmdBuffer* cmdBuffer;  ///< Primary command buffer of the current frame
     Queue* queue;
     Fence* fence;
 
-    Shader* vs;
-    Shader* roundedBoxShader;
+    RenderGraph* graph;
+
+    ShaderHandle vs;
+    ShaderHandle roundedBoxShader;
 
     Vec<UIDrawCmd> drawCommands;
 
-    CpuVisibleBuffer* vertexBuffer;
+    BufferHandle vertexBuffer;
+
+    // Resolved once in the constructor so frames are recorded without holding Device::lockObjects
+    VkShaderEXT vkVs;
+    VkShaderEXT vkRoundedBoxShader;
+    VkPipelineLayout roundedBoxLayout;
+    VkBuffer vkVertexBuffer;
 
     u32 width, height;
 
    public:
-    UIRenderer(Device* device, Surface* surface, u32 width, u32 height);
+    /// Draws are recorded inline without a job system
+    UIRenderer(Device* device, JobSystem* jobSystem, Surface* surface, u32 width, u32 height);
     ~UIRenderer();
 
-    void render(const UIDrawData& drawData,u32 imageIndex, Semaphore* imageAvailable, Semaphore* renderFinished);
+    /**
+     * @brief Records and submits the draws of a frame into a swapchain image.
+     *
+     * @param damage What has to be redrawn into this image, see DamageTracker::getBufferDamage. Everything
+     * else keeps what the image was last presented with.
+     */
+    void render(const UIDrawData& drawData, u32 imageIndex, const Damage& damage, Semaphore* imageAvailable,
+                Semaphore* renderFinished);
     void resize(u32 width, u32 height);
 
    private:
-    void recordCommandBuffer(const UIDrawData& drawData);
+    void recordUIPass(const UIDrawData& drawData);
+    void recordDamagedUIPass(const UIDrawData& drawData, const Vec<IRect>& rects);
+    void setupUIState(CmdBuffer* cmd);
+    void recordDraws(CmdBuffer* cmd, const Vec<UIDrawCmd>& commands, u64 begin, u64 end);
+    void recordDraw(CmdBuffer* cmd, const UIDrawCmd& draw);
     void setVertexBufferRect(const Rect& rect);
 };
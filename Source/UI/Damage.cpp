@@ -0,0 +1,112 @@
+#include "Damage.hpp"
+
+#include <cmath>
+#include <cstring>
+
+// The rounded box shader antialiases its edge over about a pixel on either side
+const i32 EDGE_PADDING = 2;
+
+static bool isSameCommand(const UIDrawCmd& a, const UIDrawCmd& b) {
+    if (a.kind != b.kind) return false;
+    switch (a.kind) {
+        case UIDrawCmdKind::RoundedBox:
+            return std::memcmp(&a.roundedBox, &b.roundedBox, sizeof(UIDrawCmdRoundedBox)) == 0;
+        default: return false;
+    }
+}
+
+void DamageTracker::update(const Vec<UIDrawCmd>& commands, u32 width, u32 height) {
+    frame++;
+    Damage& damage = history[frame % MAX_AGE];
+    damage.rects.clear();
+    damage.full = false;
+
+    if (frame == 1 or (i32)width != bounds.w or (i32)height != bounds.h) {
+        bounds = {0, 0, (i32)width, (i32)height};
+        setFull(damage);
+    } else {
+        // A command that moved damages both where it was and where it is now
+        u64 count = std::max(commands.getSize(), previousCommands.getSize());
+        for (u64 i = 0; i < count and !damage.full; i++) {
+            bool inNew = i < commands.getSize(), inOld = i < previousCommands.getSize();
+            if (inNew and inOld and isSameCommand(commands[i], previousCommands[i])) continue;
+            if (inOld) addRect(damage, getBounds(previousCommands[i]));
+            if (inNew) addRect(damage, getBounds(commands[i]));
+        }
+    }
+
+    previousCommands = commands;
+}
+
+void DamageTracker::invalidateBuffers() { bufferFrames.clear(); }
+
+Damage DamageTracker::getBufferDamage(u32 buffer) {
+    if (buffer >= bufferFrames.getSize()) bufferFrames.resize(buffer + 1);
+    u64 last             = bufferFrames[buffer];
+    bufferFrames[buffer] = frame;
+
+    Damage damage{.full = false};
+    if (last == 0 or frame - last > MAX_AGE) {
+        setFull(damage);
+        return damage;
+    }
+    for (u64 f = last + 1; f <= frame and !damage.full; f++) {
+        const Damage& d = history[f % MAX_AGE];
+        if (d.full)
+            setFull(damage);
+        else
+            for (const IRect& r : d.rects) addRect(damage, r);
+    }
+    return damage;
+}
+
+IRect DamageTracker::getBounds(const UIDrawCmd& command) {
+    switch (command.kind) {
+        case UIDrawCmdKind::RoundedBox: {
+            Rect r = command.roundedBox.rect;
+            i32 x0 = (i32)std::floor(r.x) - EDGE_PADDING, y0 = (i32)std::floor(r.y) - EDGE_PADDING;
+            i32 x1 = (i32)std::ceil(r.x + r.w) + EDGE_PADDING, y1 = (i32)std::ceil(r.y + r.h) + EDGE_PADDING;
+            return {x0, y0, x1 - x0, y1 - y0};
+        }
+        default: return {};
+    }
+}
+
+void DamageTracker::addRect(Damage& damage, IRect rect) const {
+    rect = rect.clip(bounds);
+    if (damage.full or rect.isEmpty()) return;
+
+    // Overlapping rects are absorbed, the grown rect may then overlap ones that were already checked
+    for (u64 i = 0; i < damage.rects.getSize();) {
+        if (damage.rects[i].intersects(rect)) {
+            rect = rect.merge(damage.rects[i]);
+            damage.rects.remove(i);
+            i = 0;
+        } else
+            i++;
+    }
+    damage.rects.push(rect);
+    if (damage.rects.getSize() <= MAX_RECTS) return;
+
+    // Too many rects, merge the pair whose bounding rect adds the least undamaged area
+    u64 bestA = 0, bestB = 1;
+    i64 bestCost = INT64_MAX;
+    for (u64 a = 0; a < damage.rects.getSize(); a++) {
+        for (u64 b = a + 1; b < damage.rects.getSize(); b++) {
+            const IRect& ra = damage.rects[a];
+            const IRect& rb = damage.rects[b];
+            i64 cost        = (i64)ra.merge(rb).getArea() - (i64)ra.getArea() - (i64)rb.getArea();
+            if (cost < bestCost) bestCost = cost, bestA = a, bestB = b;
+        }
+    }
+    IRect merged = damage.rects[bestA].merge(damage.rects[bestB]);
+    damage.rects.remove(bestB);
+    damage.rects.remove(bestA);
+    addRect(damage, merged);
+}
+
+void DamageTracker::setFull(Damage& damage) const {
+    damage.full = true;
+    damage.rects.clear();
+    damage.rects.push(bounds);
+}
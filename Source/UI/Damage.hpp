@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Core/Core.hpp"
+#include "Core/Math.hpp"
+#include "DrawData.hpp"
+
+/// Pixels that have to be redrawn, in window coordinates
+struct Damage {
+    Vec<IRect> rects;  ///< Disjoint after merging, empty if nothing changed
+    bool full = true;  ///< The whole window changed, rects then only holds its bounds
+};
+
+/**
+ * @brief Tracks which parts of a window changed between frames, from the draw commands of the widget tree.
+ *
+ * The commands of a frame are compared with the ones of the previous frame by index, everything a command
+ * that changed, appeared or disappeared covers in either frame is damaged. The rects are merged into at most
+ * MAX_RECTS, so the renderer can restrict its work with one scissor per rect.
+ *
+ * Swapchain images still hold the frame they were last drawn in, so an image has to be redrawn wherever
+ * anything was damaged since then. The damage of the last MAX_AGE frames is kept for that, see
+ * getBufferDamage.
+ */
+class DamageTracker {
+   public:
+    static constexpr u64 MAX_RECTS = 8;
+    /// Buffers last drawn further back than this are redrawn fully
+    static constexpr u64 MAX_AGE = 4;
+
+   private:
+    Vec<UIDrawCmd> previousCommands;
+    IRect bounds;
+
+    Damage history[MAX_AGE];  ///< Indexed by frame % MAX_AGE
+    u64 frame = 0;
+    Vec<u64> bufferFrames;  ///< Frame every buffer was last drawn in, 0 if its contents are unknown
+
+   public:
+    /// Compares the commands with the ones of the previous frame, called once per frame before drawing
+    void update(const Vec<UIDrawCmd>& commands, u32 width, u32 height);
+
+    /// Forgets the contents of every buffer, e.g. after the swapchain was recreated
+    void invalidateBuffers();
+
+    /// What changed since the previous frame, which is what the compositor has to update
+    [[nodiscard]] inline const Damage& getFrameDamage() const { return history[frame % MAX_AGE]; }
+
+    /**
+     * @brief Returns what has to be redrawn into a buffer for it to show the current frame and marks it as
+     * drawn.
+     *
+     * @param buffer Index of the swapchain image that was acquired.
+     */
+    Damage getBufferDamage(u32 buffer);
+
+    /// Pixels a command can touch, including the antialiased edge
+    static IRect getBounds(const UIDrawCmd& command);
+
+   private:
+    void addRect(Damage& damage, IRect rect) const;
+    void setFull(Damage& damage) const;
+};